@@ -0,0 +1,117 @@
+#pragma once
+
+#include "FitArena.hpp"
+
+#include <math.h>
+
+// Symmetric matrix that is zero further than bandwidth off the diagonal, positive definite for Cholesky.
+// Only the lower band is stored, n*(bandwidth+1) doubles, so a system of n unknowns is factored
+// in O(n*bandwidth^2) and solved in O(n*bandwidth), where a dense solver would need O(n^3).
+// Storage comes from the current FitArena.
+struct BandedMatrix
+{
+    const int n, bandwidth;
+
+    BandedMatrix(const int n, const int bandwidth) : n(n), bandwidth(bandwidth), contents(n * (bandwidth+1), 0.0) {}
+
+    // Lower band only, x <= y && y - x <= bandwidth.
+    double Get(const int y, const int x) const{
+        return contents[GetIdx(y, x)];
+    }
+
+    double& operator()(const int y, const int x){
+        return contents[GetIdx(y, x)];
+    }
+
+    // A = L * L^T in place, L takes the place of the lower band.
+    // Returns false if A is not positive definite, A is left partially factored then.
+    bool Cholesky(){
+        for (int j = 0; j < n; j++)
+        {
+            const int first = j - bandwidth > 0 ? j - bandwidth : 0;
+
+            double diagonal = Get(j, j);
+            for (int k = first; k < j; k++) diagonal -= Get(j, k) * Get(j, k);
+            if (!(diagonal > 0)) return false;
+            const double ljj = sqrt(diagonal);
+            (*this)(j, j) = ljj;
+
+            // Column j of L, only the rows the band reaches.
+            const int last = j + bandwidth < n - 1 ? j + bandwidth : n - 1;
+            for (int i = j+1; i <= last; i++)
+            {
+                double lij = Get(i, j);
+                const int first_i = i - bandwidth > first ? i - bandwidth : first;
+                for (int k = first_i; k < j; k++) lij -= Get(i, k) * Get(j, k);
+                (*this)(i, j) = lij / ljj;
+            }
+        }
+        return true;
+    }
+
+    // L * L^T * x = b after Cholesky, b is overwritten with x.
+    // Forward substitution with L, then back substitution with L^T.
+    void SolveInPlace(double* b) const{
+        for (int i = 0; i < n; i++)
+        {
+            const int first = i - bandwidth > 0 ? i - bandwidth : 0;
+            double _x = b[i];
+            for (int k = first; k < i; k++) _x -= Get(i, k) * b[k];
+            b[i] = _x / Get(i, i);
+        }
+        for (int i = n-1; i >= 0; i--)
+        {
+            const int last = i + bandwidth < n - 1 ? i + bandwidth : n - 1;
+            double _x = b[i];
+            for (int k = i+1; k <= last; k++) _x -= Get(k, i) * b[k];
+            b[i] = _x / Get(i, i);
+        }
+    }
+
+    // A = L * D * L^T in place for a symmetric A that need not be definite, a KKT system for one.
+    // No pivoting, the order of the unknowns has to keep the pivots away from zero. L has a unit diagonal
+    // and takes the place of the band below it, D the place of the diagonal. Returns false on a zero pivot.
+    bool LDLT(){
+        for (int j = 0; j < n; j++)
+        {
+            const int first = j - bandwidth > 0 ? j - bandwidth : 0;
+
+            double d = Get(j, j);
+            for (int k = first; k < j; k++) d -= Get(j, k) * Get(j, k) * Get(k, k);
+            if (d == 0 || d != d) return false;
+            (*this)(j, j) = d;
+
+            const int last = j + bandwidth < n - 1 ? j + bandwidth : n - 1;
+            for (int i = j+1; i <= last; i++)
+            {
+                double lij = Get(i, j);
+                const int first_i = i - bandwidth > first ? i - bandwidth : first;
+                for (int k = first_i; k < j; k++) lij -= Get(i, k) * Get(j, k) * Get(k, k);
+                (*this)(i, j) = lij / d;
+            }
+        }
+        return true;
+    }
+
+    // L * D * L^T * x = b after LDLT, b is overwritten with x.
+    void SolveLDLTInPlace(double* b) const{
+        for (int i = 0; i < n; i++)
+        {
+            const int first = i - bandwidth > 0 ? i - bandwidth : 0;
+            for (int k = first; k < i; k++) b[i] -= Get(i, k) * b[k];
+        }
+        for (int i = 0; i < n; i++) b[i] /= Get(i, i);
+        for (int i = n-1; i >= 0; i--)
+        {
+            const int last = i + bandwidth < n - 1 ? i + bandwidth : n - 1;
+            for (int k = i+1; k <= last; k++) b[i] -= Get(k, i) * b[k];
+        }
+    }
+
+private:
+    ArenaVector<double> contents; // Row y holds columns y-bandwidth .. y
+
+    int GetIdx(const int y, const int x) const{
+        return y * (bandwidth+1) + (x - y + bandwidth);
+    }
+};
@@ -1,14 +1,33 @@
 #include "CurveFitting.hpp"
+#include "FixedMatrix.hpp"
+#include "SimdKernels.hpp"
+#include "FitArena.hpp"
+#include "BandedMatrix.hpp"
+#include "TaskPool.hpp"
 
 #include "assert.h"
 
 #include <math.h>
 #include <deque>
 #include <memory>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#ifdef DEBUG_CF
+#include "OneEuroFilter.hpp"
+#include <atomic>
+#endif
 
 using namespace std;
 
-#define vec vector<float>
+// All fitting scratch comes from the thread's FitArena while an ArenaScope is open.
+// Public entry points open one, nothing allocated with vec may escape them.
+#define vec vector<float, ArenaAllocator<float>>
 
 const float sign(float val){ 
     return (val >= 0) ? 1.0 : -1.0;
@@ -19,6 +38,14 @@ bool floatIsZero(float a)
     return fabs(a) < numeric_limits<float>::epsilon();
 }
 
+#ifdef DEBUG_CF
+// Bytes of Vector/Matrix/QR storage deep copied, so copies sneaking back in show up.
+size_t copied_bytes = 0;
+#define COUNT_COPY(bytes) (copied_bytes += (bytes))
+#else
+#define COUNT_COPY(bytes)
+#endif
+
 const float Point::len() const {
     return sqrtf(x*x + y*y);
 }
@@ -34,9 +61,542 @@ void Point::DebugDisplay(const char* name) const{
     printf("\\Point\n\n");
 }
 
-struct Vector
+//------------------------------------------------------------------------------------------------
+
+PointBuffer::PointBuffer(PointBuffer&& other) noexcept : 
+    xs(other.xs), ys(other.ys), count(other.count), capacity(other.capacity)
+{
+    other.xs = other.ys = nullptr;
+    other.count = other.capacity = 0;
+}
+
+PointBuffer& PointBuffer::operator=(const PointBuffer& other){
+    if (this != &other) Assign(other.xs, other.ys, other.count);
+    return *this;
+}
+
+PointBuffer& PointBuffer::operator=(PointBuffer&& other) noexcept{
+    swap(xs, other.xs);
+    swap(ys, other.ys);
+    swap(count, other.count);
+    swap(capacity, other.capacity);
+    return *this;
+}
+
+PointBuffer::~PointBuffer(){
+    ::operator delete(xs, align_val_t(ALIGNMENT));
+    ::operator delete(ys, align_val_t(ALIGNMENT));
+}
+
+void PointBuffer::Reserve(const size_t new_capacity){
+    if (new_capacity <= capacity) return;
+    float* new_xs = static_cast<float*>(::operator new(new_capacity * sizeof(float), align_val_t(ALIGNMENT)));
+    float* new_ys = static_cast<float*>(::operator new(new_capacity * sizeof(float), align_val_t(ALIGNMENT)));
+    copy(xs, xs + count, new_xs);
+    copy(ys, ys + count, new_ys);
+    ::operator delete(xs, align_val_t(ALIGNMENT));
+    ::operator delete(ys, align_val_t(ALIGNMENT));
+    xs = new_xs;
+    ys = new_ys;
+    capacity = new_capacity;
+}
+
+void PointBuffer::PushBack(const Point p){
+    if (count == capacity) Reserve(max((size_t)16, capacity * 2));
+    xs[count] = p.x;
+    ys[count] = p.y;
+    count++;
+}
+
+void PointBuffer::Assign(const vector<Point>& points){
+    Reserve(points.size());
+    count = points.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        xs[i] = points[i].x;
+        ys[i] = points[i].y;
+    }
+}
+
+void PointBuffer::Assign(const float* x, const float* y, const size_t new_count){
+    Reserve(new_count);
+    count = new_count;
+    copy(x, x + count, xs);
+    copy(y, y + count, ys);
+}
+
+void PointBuffer::AssignInterleaved(const float* xy, const size_t new_count){
+    Reserve(new_count);
+    count = new_count;
+    for (size_t i = 0; i < count; i++)
+    {
+        xs[i] = xy[i*2 + 0];
+        ys[i] = xy[i*2 + 1];
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+// Expression templates.
+// Element wise Vector/Matrix arithmetic only builds a lazy expression. Nothing is computed until
+// the expression is assigned to a Vector/Matrix, which evaluates all of it in a single loop into
+// a single allocation, or into an existing buffer with EvaluateInto.
+// Expressions keep references to their Vector/Matrix operands, evaluate before those go away.
+
+struct Vector;
+struct Matrix;
+
+// Storage order of a Matrix.
+enum class Layout
+{
+    RowMajor,
+    ColumnMajor,
+};
+
+// Leaves are held by reference, intermediate expressions by value.
+template<typename E> struct ExpressionOperand { typedef const E type; };
+template<> struct ExpressionOperand<Vector> { typedef const Vector& type; };
+template<> struct ExpressionOperand<Matrix> { typedef const Matrix& type; };
+
+struct AddOp
+{
+    static float Apply(const float a, const float b) { return a + b; }
+    static auto Kernel() { return Simd().add; }
+};
+
+struct SubOp
+{
+    static float Apply(const float a, const float b) { return a - b; }
+    static auto Kernel() { return Simd().sub; }
+};
+
+template<typename E>
+struct VectorExpression
+{
+    const E& Self() const { return static_cast<const E&>(*this); }
+
+    // Both walk the expression once, without allocating.
+    const float Magnitude() const{
+        const E& self = Self();
+        float square_sum = 0;
+        for (size_t i = 0; i < self.Size(); i++)
+        {
+            const float v = self.At(i);
+            square_sum += v*v;
+        }
+        return sqrtf(square_sum);
+    }
+
+    const Vector Normalize() const;
+};
+
+template<typename L, typename R, typename Op>
+struct VectorBinary : VectorExpression<VectorBinary<L, R, Op>>
+{
+    typename ExpressionOperand<L>::type lhs;
+    typename ExpressionOperand<R>::type rhs;
+
+    VectorBinary(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs){
+        assert(lhs.Size() == rhs.Size(), "Mismatched vectors are not allowed.");
+    }
+
+    size_t Size() const { return lhs.Size(); }
+    float At(const size_t i) const { return Op::Apply(lhs.At(i), rhs.At(i)); }
+
+    void EvaluateInto(float* out) const{
+        if constexpr (is_same<L, Vector>::value && is_same<R, Vector>::value) {
+            Op::Kernel()(lhs.Data(), rhs.Data(), out, Size());
+            return;
+        }
+        for (size_t i = 0; i < Size(); i++) out[i] = At(i);
+    }
+};
+
+template<typename E>
+struct VectorScaled : VectorExpression<VectorScaled<E>>
+{
+    typename ExpressionOperand<E>::type operand;
+    const float factor;
+
+    VectorScaled(const E& operand, const float factor) : operand(operand), factor(factor) {}
+
+    size_t Size() const { return operand.Size(); }
+    float At(const size_t i) const { return operand.At(i) * factor; }
+
+    void EvaluateInto(float* out) const{
+        if constexpr (is_same<E, Vector>::value) {
+            Simd().scale(operand.Data(), factor, out, Size());
+            return;
+        }
+        for (size_t i = 0; i < Size(); i++) out[i] = At(i);
+    }
+};
+
+template<typename L, typename R>
+const VectorBinary<L, R, AddOp> operator+(const VectorExpression<L>& lhs, const VectorExpression<R>& rhs){
+    return VectorBinary<L, R, AddOp>(lhs.Self(), rhs.Self());
+}
+
+template<typename L, typename R>
+const VectorBinary<L, R, SubOp> operator-(const VectorExpression<L>& lhs, const VectorExpression<R>& rhs){
+    return VectorBinary<L, R, SubOp>(lhs.Self(), rhs.Self());
+}
+
+template<typename E>
+const VectorScaled<E> operator*(const VectorExpression<E>& lhs, const float rhs){
+    return VectorScaled<E>(lhs.Self(), rhs);
+}
+
+template<typename E>
+const VectorScaled<E> operator*(const float lhs, const VectorExpression<E>& rhs){
+    return VectorScaled<E>(rhs.Self(), lhs);
+}
+
+template<typename E>
+const VectorScaled<E> operator/(const VectorExpression<E>& lhs, const float rhs){
+    return VectorScaled<E>(lhs.Self(), 1 / rhs); // Lessen the number of divisions
+}
+
+template<typename E>
+struct MatrixExpression
+{
+    const E& Self() const { return static_cast<const E&>(*this); }
+};
+
+// Element wise, elements are addressed by their row major index.
+template<typename L, typename R, typename Op>
+struct MatrixBinary : MatrixExpression<MatrixBinary<L, R, Op>>
+{
+    typename ExpressionOperand<L>::type lhs;
+    typename ExpressionOperand<R>::type rhs;
+
+    MatrixBinary(const L& lhs, const R& rhs) : lhs(lhs), rhs(rhs){
+        assert(lhs.Rows() == rhs.Rows(), "Matrix dimensions must equal!");
+        assert(lhs.Cols() == rhs.Cols(), "Matrix dimensions must equal!");
+    }
+
+    int Rows() const { return lhs.Rows(); }
+    int Cols() const { return lhs.Cols(); }
+    float At(const size_t idx) const { return Op::Apply(lhs.At(idx), rhs.At(idx)); }
+
+    void EvaluateInto(float* out) const{
+        const size_t count = (size_t)Rows() * Cols();
+        if constexpr (is_same<L, Matrix>::value && is_same<R, Matrix>::value) {
+            if (lhs.GetLayout() == Layout::RowMajor && rhs.GetLayout() == Layout::RowMajor) {
+                Op::Kernel()(lhs.Data(), rhs.Data(), out, count);
+                return;
+            }
+        }
+        for (size_t i = 0; i < count; i++) out[i] = At(i);
+    }
+};
+
+template<typename E>
+struct MatrixScaled : MatrixExpression<MatrixScaled<E>>
+{
+    typename ExpressionOperand<E>::type operand;
+    const float factor;
+
+    MatrixScaled(const E& operand, const float factor) : operand(operand), factor(factor) {}
+
+    int Rows() const { return operand.Rows(); }
+    int Cols() const { return operand.Cols(); }
+    float At(const size_t idx) const { return operand.At(idx) * factor; }
+
+    void EvaluateInto(float* out) const{
+        const size_t count = (size_t)Rows() * Cols();
+        if constexpr (is_same<E, Matrix>::value) {
+            if (operand.GetLayout() == Layout::RowMajor) {
+                Simd().scale(operand.Data(), factor, out, count);
+                return;
+            }
+        }
+        for (size_t i = 0; i < count; i++) out[i] = At(i);
+    }
+};
+
+template<typename L, typename R>
+const MatrixBinary<L, R, AddOp> operator+(const MatrixExpression<L>& lhs, const MatrixExpression<R>& rhs){
+    return MatrixBinary<L, R, AddOp>(lhs.Self(), rhs.Self());
+}
+
+template<typename L, typename R>
+const MatrixBinary<L, R, SubOp> operator-(const MatrixExpression<L>& lhs, const MatrixExpression<R>& rhs){
+    return MatrixBinary<L, R, SubOp>(lhs.Self(), rhs.Self());
+}
+
+template<typename E>
+const MatrixScaled<E> operator*(const MatrixExpression<E>& lhs, const float rhs){
+    return MatrixScaled<E>(lhs.Self(), rhs);
+}
+
+template<typename E>
+const MatrixScaled<E> operator*(const float lhs, const MatrixExpression<E>& rhs){
+    return MatrixScaled<E>(rhs.Self(), lhs);
+}
+
+template<typename E>
+const MatrixScaled<E> operator/(const MatrixExpression<E>& lhs, const float rhs){
+    return MatrixScaled<E>(lhs.Self(), 1 / rhs);
+}
+
+//------------------------------------------------------------------------------------------------
+// Views. Non owning, strided windows into Vector/Matrix storage, returned instead of copies.
+// A view is only valid as long as the Vector/Matrix it was taken from.
+
+struct VectorView : VectorExpression<VectorView>
+{
+    VectorView(const float* data, const size_t size, const ptrdiff_t stride) : data(data), size(size), stride(stride) {}
+
+    size_t Size() const { return size; }
+    ptrdiff_t Stride() const { return stride; }
+
+    const float Get(const size_t index) const{
+        assert(index < size, "Index must be whitin range!");
+        return At(index);
+    }
+
+    // Unchecked, for expressions.
+    float At(const size_t index) const{
+        return data[(ptrdiff_t)index * stride];
+    }
+
+    void EvaluateInto(float* out) const{
+        if (stride == 1) {
+            copy(data, data + size, out);
+            return;
+        }
+        for (size_t i = 0; i < size; i++) out[i] = At(i);
+    }
+
+    const VectorView Subsection(const int start, int count) const{
+        if (count < 0) count = Size() - start;
+        assert(start >= 0, "Start must not be negative");
+        assert(start + count <= (int)Size(), "Subsection must not exceed vector.");
+        return VectorView(data + start * stride, count, stride);
+    }
+
+    const VectorView Reverse() const{
+        if (size == 0) return *this;
+        return VectorView(data + (ptrdiff_t)(size - 1) * stride, size, -stride);
+    }
+
+    private:
+    const float* data;
+    size_t size;
+    ptrdiff_t stride;
+};
+
+// rows*cols window, element (y, x) is at data[y*row_stride + x*col_stride].
+// Covers both layouts, subsections and transposes without copying.
+struct MatrixView : MatrixExpression<MatrixView>
+{
+    MatrixView(const float* data, const int rows, const int cols, const int row_stride, const int col_stride = 1) : 
+        data(data), rows(rows), cols(cols), row_stride(row_stride), col_stride(col_stride) {}
+
+    int Rows() const { return rows; }
+    int Cols() const { return cols; }
+    int RowStride() const { return row_stride; }
+    int ColStride() const { return col_stride; }
+
+    const float Get(const int y, const int x) const{
+        assert(y >= 0 && y < rows, "Row must be whitin range!");
+        assert(x >= 0 && x < cols, "Column must be whitin range!");
+        return At(y, x);
+    }
+
+    // Unchecked
+    float At(const int y, const int x) const{
+        return data[(ptrdiff_t)y*row_stride + (ptrdiff_t)x*col_stride];
+    }
+
+    // Unchecked row major index, for expressions.
+    float At(const size_t idx) const{
+        return At((int)(idx / cols), (int)(idx % cols));
+    }
+
+    // Start of row y, the row is contiguous when ColStride() == 1.
+    const float* RowPointer(const int y) const{
+        return data + (ptrdiff_t)y*row_stride;
+    }
+
+    void EvaluateInto(float* out) const{
+        for (int y = 0; y < rows; y++)
+        {
+            for (int x = 0; x < cols; x++) out[y*cols + x] = At(y, x);
+        }
+    }
+
+    // A column of a row major matrix is a stride walk.
+    const VectorView ExtractColumn(const int column) const{
+        assert(column >= 0, "Column must not be negative!");
+        assert(column < cols, "Column must be whitin range of matrix!");
+        return VectorView(data + (ptrdiff_t)column*col_stride, rows, row_stride);
+    }
+
+    const VectorView ExtractRow(const int row) const{
+        assert(row >= 0, "Row must not be negative!");
+        assert(row < rows,  "Row must be whitin range of matrix!");
+        return VectorView(data + (ptrdiff_t)row*row_stride, cols, col_stride);
+    }
+
+    // Inclusive bounds, -1 means until the last row/column.
+    const MatrixView Subsection(const int startCol, int endCol, const int startRow, int endRow) const{
+        if (endCol < 0) endCol = cols-1;
+        if (endRow < 0) endRow = rows-1;
+
+        assert(startCol >= 0, "Column cannot be negative!");
+        assert(startRow >= 0, "Row cannot be negative!");
+
+        assert(endCol < cols, "Column must be whitin range!");
+        assert(endRow < rows, "Row must be whitin range!");
+
+        assert(startCol <= endCol, "End cannot be before start!");
+        assert(startRow <= endRow, "End cannot be before start!");
+
+        return MatrixView(data + (ptrdiff_t)startRow*row_stride + (ptrdiff_t)startCol*col_stride, 
+            endRow - startRow + 1, endCol - startCol + 1, row_stride, col_stride);
+    }
+
+    const MatrixView Transposed() const{
+        return MatrixView(data, cols, rows, col_stride, row_stride);
+    }
+
+    private:
+    const float* data;
+    int rows, cols;
+    int row_stride, col_stride;
+};
+
+//------------------------------------------------------------------------------------------------
+// Matrix products
+
+// Row _m of the result is the sum of the rows of rhs weighted by row _m of lhs.
+// No packing, so it wins for the tiny products of the fit.
+void multiply_rows(const MatrixView& lhs, const MatrixView& rhs, float* C){
+    const int res_m = lhs.Rows(), res_n = rhs.Cols();
+    fill(C, C + res_m*res_n, 0.0f);
+    for (int _m = 0; _m < res_m; _m++)
+    {
+        float* result_row = C + _m*res_n;
+        for (int i = 0; i < lhs.Cols(); i++)
+        {
+            const float lhs_value = lhs.At(_m, i);
+            if (rhs.ColStride() == 1) {
+                Simd().axpy(lhs_value, rhs.RowPointer(i), result_row, res_n);
+                continue;
+            }
+            for (int _n = 0; _n < res_n; _n++) result_row[_n] += lhs_value * rhs.At(i, _n);
+        }
+    }
+}
+
+// Cache blocking of the packed GEMM. A KC*NC block of B stays in L2/L3, an MC*KC block of A in L2,
+// a KC*GEMM_NR panel of B in L1 while the micro kernel sweeps the panels of A over it.
+static const int GEMM_MC = 128;
+static const int GEMM_KC = 256;
+static const int GEMM_NC = 2048;
+
+// C = A * B, C is row major. Blocks of A and B are packed into contiguous, zero padded panels first,
+// so strides and layouts of the operands cost nothing in the inner loop.
+void multiply_blocked(const MatrixView& A, const MatrixView& B, float* C){
+    const int M = A.Rows(), N = B.Cols(), K = A.Cols();
+    fill(C, C + M*N, 0.0f);
+
+    ArenaScope scratch;
+    const int mc_max = min(GEMM_MC, (M + GEMM_MR - 1) / GEMM_MR * GEMM_MR);
+    const int nc_max = min(GEMM_NC, (N + GEMM_NR - 1) / GEMM_NR * GEMM_NR);
+    const int kc_max = min(GEMM_KC, K);
+    vec a_pack(mc_max * kc_max);
+    vec b_pack(kc_max * nc_max);
+    float tile[GEMM_MR * GEMM_NR];
+    const auto micro_kernel = Simd().gemm_micro;
+
+    for (int jc = 0; jc < N; jc += GEMM_NC)
+    {
+        const int nc = min(GEMM_NC, N - jc);
+        for (int pc = 0; pc < K; pc += GEMM_KC)
+        {
+            const int kc = min(GEMM_KC, K - pc);
+
+            // B[pc:pc+kc, jc:jc+nc] -> panels of kc rows x GEMM_NR
+            for (int jr = 0; jr < nc; jr += GEMM_NR)
+            {
+                float* panel = b_pack.data() + (jr / GEMM_NR) * kc * GEMM_NR;
+                const int nr = min(GEMM_NR, nc - jr);
+                for (int p = 0; p < kc; p++)
+                {
+                    for (int j = 0; j < GEMM_NR; j++) panel[p*GEMM_NR + j] = j < nr ? B.At(pc + p, jc + jr + j) : 0;
+                }
+            }
+
+            for (int ic = 0; ic < M; ic += GEMM_MC)
+            {
+                const int mc = min(GEMM_MC, M - ic);
+
+                // A[ic:ic+mc, pc:pc+kc] -> panels of kc columns x GEMM_MR
+                for (int ir = 0; ir < mc; ir += GEMM_MR)
+                {
+                    float* panel = a_pack.data() + (ir / GEMM_MR) * kc * GEMM_MR;
+                    const int mr = min(GEMM_MR, mc - ir);
+                    for (int p = 0; p < kc; p++)
+                    {
+                        for (int i = 0; i < GEMM_MR; i++) panel[p*GEMM_MR + i] = i < mr ? A.At(ic + ir + i, pc + p) : 0;
+                    }
+                }
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR)
+                {
+                    const int nr = min(GEMM_NR, nc - jr);
+                    for (int ir = 0; ir < mc; ir += GEMM_MR)
+                    {
+                        const int mr = min(GEMM_MR, mc - ir);
+                        micro_kernel(kc, a_pack.data() + (ir / GEMM_MR) * kc * GEMM_MR, b_pack.data() + (jr / GEMM_NR) * kc * GEMM_NR, tile);
+
+                        for (int i = 0; i < mr; i++)
+                        {
+                            float* c_row = C + (size_t)(ic + ir + i) * N + jc + jr;
+                            for (int j = 0; j < nr; j++) c_row[j] += tile[i*GEMM_NR + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Below this many multiply-adds packing costs more than it saves.
+// Results narrower than half a micro tile waste most of the tile on padding.
+static const long GEMM_BLOCKED_MIN_FLOPS = 32 * 32 * 32;
+static const int GEMM_BLOCKED_MIN_COLS = GEMM_NR / 2;
+
+vec multiply(const MatrixView& lhs, const MatrixView& rhs){
+    assert(lhs.Cols() == rhs.Rows(), "Invalid multiplication!");
+    vec result((size_t)lhs.Rows() * rhs.Cols());
+    const bool small = (long)lhs.Rows() * lhs.Cols() * rhs.Cols() < GEMM_BLOCKED_MIN_FLOPS;
+    if (small || rhs.Cols() < GEMM_BLOCKED_MIN_COLS) multiply_rows(lhs, rhs, result.data());
+    else multiply_blocked(lhs, rhs, result.data());
+    return result;
+}
+
+//------------------------------------------------------------------------------------------------
+
+struct Vector : VectorExpression<Vector>
 {
-    Vector(const vec contents) : contents(contents) {}
+    Vector(const vec& contents) : contents(contents) { COUNT_COPY(contents.size() * sizeof(float)); }
+    Vector(vec&& contents) : contents(move(contents)) {}
+
+    template<typename E>
+    Vector(const VectorExpression<E>& expression) : contents(evaluate(expression.Self())) {}
+
+    Vector(const Vector& other) : contents(other.contents) { COUNT_COPY(other.Size() * sizeof(float)); }
+    Vector(Vector&& other) = default;
+
+    Vector& operator=(const Vector& other){
+        contents = other.contents;
+        COUNT_COPY(other.Size() * sizeof(float));
+        return *this;
+    }
+    Vector& operator=(Vector&& other) = default;
 
     static const Vector CreateBaseFor(const int row, const int height){
         vec result(height, 0);
@@ -64,569 +624,3273 @@ struct Vector
         return contents[index];
     }
 
-    const Vector Subsection(const int start, int count) const{
+    const VectorView View() const{
+        return VectorView(contents.data(), contents.size(), 1);
+    }
+
+    const VectorView Subsection(const int start, int count) const{
         if (count < 0) count = Size() - start;
         
         assert(start >= 0, "Start must not be negative"); 
-        assert(start < (int)Size(), "Start must exceed length"); 
+        assert(start <= (int)Size(), "Start must not exceed length"); 
 
         assert(start + count <= (int)Size(), "Subsection must not exceed vector.");
 
-        if(count == 0) return vec();
+        return View().Subsection(start, count);
+    }
+
+    const VectorView Reverse() const{
+        return View().Reverse();
+    }
+
+    // Unchecked, for expressions.
+    float At(const size_t index) const{
+        return contents[index];
+    }
+
+    const float* Data() const{
+        return contents.data();
+    }
+
+    void EvaluateInto(float* out) const{
+        copy(contents.begin(), contents.end(), out);
+    }
+
+    const float Dot(const Vector& rhs) const{
+        assert(Size() == rhs.Size(), "Mismatched vectors are not allowed.");
+        return Simd().dot(contents.data(), rhs.contents.data(), Size());
+    }
+
+    const float Magnitude() const{
+        return sqrtf(Simd().dot(contents.data(), contents.data(), Size()));
+    }
+
+    const Vector Normalize() const& {
+        const float magnitude = Magnitude();
+        if (magnitude == 0) return *this;
+        return *this / magnitude;
+    }
+
+    // A temporary is normalized in its own storage.
+    Vector Normalize() && {
+        const float magnitude = Magnitude();
+        if (magnitude != 0) *this /= magnitude;
+        return move(*this);
+    }
+
+    // Element wise, in place. The expression may refer to this vector, every element only reads its own index.
+    template<typename E>
+    Vector& operator+=(const VectorExpression<E>& rhs){
+        return apply<AddOp>(rhs.Self());
+    }
+
+    template<typename E>
+    Vector& operator-=(const VectorExpression<E>& rhs){
+        return apply<SubOp>(rhs.Self());
+    }
+
+    Vector& operator*=(const float rhs){
+        Simd().scale(contents.data(), rhs, contents.data(), Size());
+        return *this;
+    }
+
+    Vector& operator/=(const float rhs){
+        return *this *= 1 / rhs;
+    }
+
+    float* Data(){
+        return contents.data();
+    }
+
+    explicit operator vec() const& { COUNT_COPY(Size() * sizeof(float)); return contents; }
+    explicit operator vec() && { return move(contents); }
+
+    private:
+    vec contents;
+
+    template<typename Op, typename E>
+    Vector& apply(const E& rhs){
+        assert(Size() == rhs.Size(), "Mismatched vectors are not allowed.");
+        if constexpr (is_same<E, Vector>::value) {
+            Op::Kernel()(contents.data(), rhs.Data(), contents.data(), Size());
+        }
+        else {
+            for (size_t i = 0; i < Size(); i++) contents[i] = Op::Apply(contents[i], rhs.At(i));
+        }
+        return *this;
+    }
+
+    template<typename E>
+    static const vec evaluate(const E& expression){
+        vec result(expression.Size());
+        expression.EvaluateInto(result.data());
+        return result;
+    }
+};
+
+template<typename E>
+const Vector VectorExpression<E>::Normalize() const{
+    const float magnitude = Magnitude();
+    if (magnitude == 0) return Self();
+    return Self() / magnitude;
+}
+
+struct Matrix : MatrixExpression<Matrix>
+{
+    private:
+    vec contents;
+    int m, n;
+    Layout layout;
+
+    template<typename E>
+    static const vec evaluate(const E& expression){
+        vec result((size_t)expression.Rows() * expression.Cols());
+        expression.EvaluateInto(result.data());
+        return result;
+    }
+
+    public:
+    Matrix(int m, int n, const vec& from_vec, const Layout layout = Layout::RowMajor) : contents(from_vec), m(m), n(n), layout(layout){
+        assert((int)from_vec.size() == m*n, "Input vector must fill give m*n matrix!");
+        COUNT_COPY(from_vec.size() * sizeof(float));
+    }
+
+    Matrix(int m, int n, vec&& from_vec, const Layout layout = Layout::RowMajor) : contents(move(from_vec)), m(m), n(n), layout(layout){
+        assert((int)contents.size() == m*n, "Input vector must fill give m*n matrix!");
+    }
+
+    // Expressions always evaluate row major.
+    template<typename E>
+    Matrix(const MatrixExpression<E>& expression) : 
+        contents(evaluate(expression.Self())), 
+        m(expression.Self().Rows()), 
+        n(expression.Self().Cols()),
+        layout(Layout::RowMajor)
+    {}
+
+    Matrix(const Vector& from_vec, bool transposed = false) : 
+        contents(from_vec), 
+        m(!transposed ? from_vec.Size() : 1),
+        n( transposed ? from_vec.Size() : 1),
+        layout(Layout::RowMajor)
+    {}
+
+    Matrix(Vector&& from_vec, bool transposed = false) : 
+        m(!transposed ? from_vec.Size() : 1),
+        n( transposed ? from_vec.Size() : 1),
+        layout(Layout::RowMajor)
+    {
+        contents = vec(move(from_vec));
+    }
+
+    Matrix(const Matrix& other) : contents(other.contents), m(other.m), n(other.n), layout(other.layout){
+        COUNT_COPY(other.contents.size() * sizeof(float));
+    }
+    Matrix(Matrix&& other) = default;
+
+    Matrix& operator=(const Matrix& other){
+        contents = other.contents;
+        m = other.m; n = other.n; layout = other.layout;
+        COUNT_COPY(other.contents.size() * sizeof(float));
+        return *this;
+    }
+    Matrix& operator=(Matrix&& other) = default;
+
+    void DebugDisplay(const char* name) const{
+        printf("Matrix %s:\n", name);
+        for (int _m = 0; _m < m; _m++)
+        {
+            printf("\t");
+            for (int _n = 0; _n < n; _n++)
+            {
+                printf("| %f ", Get(_m, _n));
+            }
+            printf("|\n");
+        }
+        printf("\\Matrix\n\n");
+    }
+
+    static const Matrix Identity(const int size){
+        assert(size > 0, "Matrix size must be bigger than 0");
+        vec result(size*size, 0);
+        for (int i = 0; i < size; i++)
+        {
+            // nth row, nth column
+            result[size * i + i] = 1;
+        }
+        return Matrix(size, size, result);
+    }
+
+    // The transpose of one layout is the other layout of the same storage.
+    const Matrix Transpose() const& {
+        return Matrix(n, m, contents, layout == Layout::RowMajor ? Layout::ColumnMajor : Layout::RowMajor);
+    }
+
+    Matrix Transpose() && {
+        return Matrix(n, m, move(contents), layout == Layout::RowMajor ? Layout::ColumnMajor : Layout::RowMajor);
+    }
+
+    // Same matrix, stored in the target layout.
+    const Matrix ToLayout(const Layout target) const{
+        if (target == layout) return *this;
+        vec result(m*n);
+        const MatrixView source = View();
+        for (int _m = 0; _m < m; _m++)
+        {
+            for (int _n = 0; _n < n; _n++)
+            {
+                result[target == Layout::RowMajor ? _m*n + _n : _n*m + _m] = source.At(_m, _n);
+            }
+        }
+        return Matrix(m, n, move(result), target);
+    }
+
+    static int GetIdx(int y, int x, int n) {
+        assert(y >= 0, "Row must not be negative!");
+        assert(x >= 0, "column must not be negative!");
+        assert(n >  0, "Height must be bigger than 0!");
+        return y * n + x;
+    }
+
+    // Index of (y, x) in the storage, depends on the layout.
+    int Index(int y, int x) const{
+        return layout == Layout::RowMajor ? GetIdx(y, x, n) : GetIdx(x, y, m);
+    }
+
+    const float Get(int y, int x) const{
+        return contents[Index(y, x)];
+    }
+
+    const vec& Contents() const{
+        return contents;
+    }
+
+    int Rows() const { return m; }
+    int Cols() const { return n; }
+    Layout GetLayout() const { return layout; }
+
+    // Unchecked row major access, for expressions.
+    float At(const size_t idx) const{
+        if (layout == Layout::RowMajor) return contents[idx];
+        return contents[(idx % n) * m + idx / n];
+    }
+
+    const float* Data() const{
+        return contents.data();
+    }
+
+    float* Data(){
+        return contents.data();
+    }
+
+    void EvaluateInto(float* out) const{
+        if (layout == Layout::RowMajor) {
+            copy(contents.begin(), contents.end(), out);
+            return;
+        }
+        View().EvaluateInto(out);
+    }
+
+    const MatrixView View() const{
+        if (layout == Layout::RowMajor) return MatrixView(contents.data(), m, n, n, 1);
+        return MatrixView(contents.data(), m, n, 1, m);
+    }
+
+    // Matrix * Vector(ColumnOriented) = Vector
+    const Vector operator*(const vec& rhs) const{
+        assert(n == (int)rhs.size(), "Invalid multiplication!");
+        vec result(m, 0);
+        if (layout == Layout::RowMajor) {
+            Simd().matvec(contents.data(), rhs.data(), result.data(), m, n);
+        }
+        else {
+            // Sum of the columns weighted by rhs.
+            for (int _n = 0; _n < n; _n++) Simd().axpy(rhs[_n], contents.data() + _n*m, result.data(), m);
+        }
+        return Vector(move(result));
+    }
+
+    // Element wise, in place, addressed by the row major index like the expressions.
+    template<typename E>
+    Matrix& operator+=(const MatrixExpression<E>& rhs){
+        return apply<AddOp>(rhs.Self());
+    }
+
+    template<typename E>
+    Matrix& operator-=(const MatrixExpression<E>& rhs){
+        return apply<SubOp>(rhs.Self());
+    }
+
+    Matrix& operator*=(const float rhs){
+        Simd().scale(contents.data(), rhs, contents.data(), contents.size());
+        return *this;
+    }
+
+    Matrix& operator/=(const float rhs){
+        return *this *= 1 / rhs;
+    }
+
+    const VectorView ExtractColumn(const int column) const{
+        return View().ExtractColumn(column);
+    }
+
+    const VectorView ExtractRow(const int row) const{
+        return View().ExtractRow(row);
+    }
+
+    const Matrix Insert(const MatrixView toInsert, int startCol, int startRow) const& {
+        // If we are gonna override the entire matrix. Dont.
+        if (toInsert.Rows() == m && toInsert.Cols() == n) return Matrix(toInsert);
+
+        vec result(m*n);
+        EvaluateInto(result.data()); // Clone recipient, row major
+        return Matrix(m, n, move(result)).Insert(toInsert, startCol, startRow);
+    }
+
+    // A temporary recipient is written in place.
+    Matrix Insert(const MatrixView toInsert, int startCol, int startRow) && {
+        const int insert_m = toInsert.Rows(), insert_n = toInsert.Cols();
+        if (startRow < 0) startRow = m - insert_m;
+        if (startCol < 0) startCol = n - insert_n;
+
+        assert(insert_m <= m, "Inserted matrix must be smaller than recipient.");
+        assert(insert_n <= n, "Inserted matrix must be smaller than recipient.");
+
+        assert(startRow + insert_m <= m, "Inserted matrix must be positioned inside recipient.");
+        assert(startCol + insert_n <= n, "Inserted matrix must be positioned inside recipient.");
+
+        for (int _m = startRow; _m < startRow + insert_m; _m++)
+        {
+            for (int _n = startCol; _n < startCol + insert_n; _n++)
+            {
+                contents[Index(_m, _n)] = toInsert.At(_m - startRow, _n - startCol);
+            }
+        }
+        return move(*this);
+    }
+
+    const Matrix Insert(const Matrix& toInsert, int startCol, int startRow) const& {
+        return Insert(toInsert.View(), startCol, startRow);
+    }
+
+    Matrix Insert(const Matrix& toInsert, int startCol, int startRow) && {
+        return move(*this).Insert(toInsert.View(), startCol, startRow);
+    }
+
+    const MatrixView Subsection(const int startCol, int endCol, const int startRow, int endRow) const{
+        return View().Subsection(startCol, endCol, startRow, endRow);
+    }
+
+    bool IsUpperTriangular() const{
+        for (int _m = 0; _m < m; _m++)
+        {
+            for (int _n = 0; _n < n; _n++)
+            {
+                // Under the diagonal is not zero.
+                if (_n < _m && !floatIsZero(Get(_m, _n))) return false;
+
+                // Diagonal cannot be 0.
+                if (_n == _m && floatIsZero(Get(_m, _n))) return false;
+            }
+            
+        }
+        return true;
+    }
+
+    private:
+    template<typename Op, typename E>
+    Matrix& apply(const E& rhs){
+        assert(m == rhs.Rows(), "Matrix dimensions must equal!");
+        assert(n == rhs.Cols(), "Matrix dimensions must equal!");
+        if constexpr (is_same<E, Matrix>::value) {
+            if (layout == rhs.layout) {
+                Op::Kernel()(contents.data(), rhs.Data(), contents.data(), contents.size());
+                return *this;
+            }
+        }
+        for (int _m = 0; _m < m; _m++)
+        {
+            for (int _n = 0; _n < n; _n++)
+            {
+                float& element = contents[Index(_m, _n)];
+                element = Op::Apply(element, rhs.At((size_t)_m*n + _n));
+            }
+        }
+        return *this;
+    }
+};
+
+// x = (I - 2*w*w^T) * x, w a unit vector.
+void apply_reflector_inplace(const Vector& w, Vector& x){
+    assert(w.Size() == x.Size(), "Mismatched vectors are not allowed.");
+    Simd().reflector_update(w.Data(), x.Data(), x.Size(), 1, 0);
+}
+
+// A = (I - 2*w*w^T) * A, every column is reflected. Contiguous columns go through the kernel directly.
+void apply_reflector_inplace(const Vector& w, Matrix& A){
+    assert((int)w.Size() == A.Rows(), "Reflector must be as tall as the matrix!");
+    if (A.GetLayout() == Layout::ColumnMajor) {
+        Simd().reflector_update(w.Data(), A.Data(), A.Rows(), A.Cols(), A.Rows());
+        return;
+    }
+    // Row major: A -= 2 * w * (w^T * A), w^T * A accumulated row by row.
+    ArenaScope scratch;
+    vec projection(A.Cols(), 0);
+    for (int _m = 0; _m < A.Rows(); _m++) Simd().axpy(w.At(_m), A.Data() + (size_t)_m*A.Cols(), projection.data(), A.Cols());
+    for (int _m = 0; _m < A.Rows(); _m++) Simd().axpy(-2 * w.At(_m), projection.data(), A.Data() + (size_t)_m*A.Cols(), A.Cols());
+}
+
+// Products are not element wise. Matrices and views are multiplied in place,
+// other expressions are evaluated first.
+inline const MatrixView evaluated(const Matrix& matrix){
+    return matrix.View();
+}
+
+inline const MatrixView& evaluated(const MatrixView& view){
+    return view;
+}
+
+template<typename E>
+const Matrix evaluated(const MatrixExpression<E>& expression){
+    return Matrix(expression);
+}
+
+inline const MatrixView as_view(const Matrix& matrix) { return matrix.View(); }
+inline const MatrixView& as_view(const MatrixView& view) { return view; }
+
+template<typename L, typename R>
+const Matrix operator*(const MatrixExpression<L>& lhs, const MatrixExpression<R>& rhs){
+    // Bound to references so evaluated temporaries live until the product is done.
+    const auto& _lhs = evaluated(lhs.Self());
+    const auto& _rhs = evaluated(rhs.Self());
+    return Matrix(lhs.Self().Rows(), rhs.Self().Cols(), multiply(as_view(_lhs), as_view(_rhs)));
+}
+
+// Temporaries on the left of an element wise operator are reused as the result instead of building an expression
+// around them, so chains like (A * B) + C - D only allocate for the product.
+template<typename R>
+Vector operator+(Vector&& lhs, const VectorExpression<R>& rhs) { return move(lhs += rhs.Self()); }
+
+template<typename R>
+Vector operator-(Vector&& lhs, const VectorExpression<R>& rhs) { return move(lhs -= rhs.Self()); }
+
+inline Vector operator*(Vector&& lhs, const float rhs) { return move(lhs *= rhs); }
+inline Vector operator/(Vector&& lhs, const float rhs) { return move(lhs /= rhs); }
+
+template<typename R>
+Matrix operator+(Matrix&& lhs, const MatrixExpression<R>& rhs) { return move(lhs += rhs.Self()); }
+
+template<typename R>
+Matrix operator-(Matrix&& lhs, const MatrixExpression<R>& rhs) { return move(lhs -= rhs.Self()); }
+
+inline Matrix operator*(Matrix&& lhs, const float rhs) { return move(lhs *= rhs); }
+inline Matrix operator/(Matrix&& lhs, const float rhs) { return move(lhs /= rhs); }
+
+//------------------------------------------------------------------------------------------------
+
+// Past this many points a float running sum stops resolving short segments, the length is carried in double instead.
+static const size_t CHORD_WIDE_SUM_MIN_POINTS = 4096;
+
+// Chord length parameter of every point into t, which must hold points.Size() floats.
+// Segment lengths, prefix sum and normalization in one SIMD sweep.
+void chord_lenght_parameterize_into(const PointBuffer& points, float* t){
+    assert(points.Size() >= 2, "Not enough points to parameterize chord length!");
+
+    const SimdKernels& simd = Simd();
+    if (points.Size() >= CHORD_WIDE_SUM_MIN_POINTS) simd.chord_parameterize_wide(points.X(), points.Y(), points.Size(), t);
+    else simd.chord_parameterize(points.X(), points.Y(), points.Size(), t);
+}
+
+template<typename T = float>
+const ArenaVector<T> chord_lenght_parameterize(const PointBuffer& points){
+    assert(points.Size() >= 2, "Not enough points to parameterize chord length!");
+
+    ArenaVector<T> result(points.Size());
+    if constexpr (is_same<T, float>::value){
+        chord_lenght_parameterize_into(points, result.data());
+    }
+    else {
+        // Same single sweep in plain loops.
+        const float* x = points.X();
+        const float* y = points.Y();
+        result[0] = 0;
+        for (size_t i = 1; i < result.size(); i++)
+        {
+            const T dx = (T)x[i] - x[i-1];
+            const T dy = (T)y[i] - y[i-1];
+            result[i] = result[i-1] + sqrt(dx*dx + dy*dy);
+        }
+        const T length = result.back();
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            result[i] /= length;
+        }
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// The dense kernels of the QR, per scalar type.
+// float goes through the SIMD dispatch, double runs plain loops.
+template<typename T>
+struct QRKernels;
+
+template<>
+struct QRKernels<float>
+{
+    static float dot(const float* a, const float* b, const size_t n){
+        return Simd().dot(a, b, n);
+    }
+
+    static void scale(const float* a, const float alpha, float* out, const size_t n){
+        Simd().scale(a, alpha, out, n);
+    }
+
+    static void reflector_update(const float* w, float* A, const size_t n, const size_t cols, const size_t column_stride){
+        Simd().reflector_update(w, A, n, cols, column_stride);
+    }
+};
+
+template<>
+struct QRKernels<double>
+{
+    static double dot(const double* a, const double* b, const size_t n){
+        double result = 0;
+        for (size_t i = 0; i < n; i++) result += a[i] * b[i];
+        return result;
+    }
+
+    static void scale(const double* a, const double alpha, double* out, const size_t n){
+        for (size_t i = 0; i < n; i++) out[i] = a[i] * alpha;
+    }
+
+    static void reflector_update(const double* w, double* A, const size_t n, const size_t cols, const size_t column_stride){
+        for (size_t c = 0; c < cols; c++)
+        {
+            double* column = A + c*column_stride;
+            const double factor = 2 * dot(w, column, n);
+            for (size_t i = 0; i < n; i++) column[i] -= factor * w[i];
+        }
+    }
+};
+
+// Compact Householder QR. Neither H nor Q is ever formed, only the reflector vectors are stored.
+// Memory is O(m*n), factoring is O(m*n^2) and applying Q^T to a vector is O(m*n).
+// Storage is column major so every reflector and column is contiguous for the SIMD kernels.
+// Column i holds the reflector w(i) from row i down and R above it, the diagonal of R is kept apart.
+template<typename T = float>
+struct HouseholderQR
+{
+    const int m, n;
+
+    HouseholderQR(const MatrixView& A) : m(A.Rows()), n(A.Cols()), columns(m*n), diagonal(n, 0){
+        for (int _n = 0; _n < n; _n++)
+        {
+            for (int _m = 0; _m < m; _m++) columns[_n*m + _m] = A.At(_m, _n);
+        }
+        COUNT_COPY(columns.size() * sizeof(T));
+        factor();
+    }
+
+    // A is column major m*n.
+    HouseholderQR(const int m, const int n, const T* A) : m(m), n(n), columns(A, A + m*n), diagonal(n, 0){
+        COUNT_COPY(columns.size() * sizeof(T));
+        factor();
+    }
+
+    // Factors A in its own storage.
+    HouseholderQR(const int m, const int n, ArenaVector<T>&& A) : m(m), n(n), columns(move(A)), diagonal(n, 0){
+        assert((int)columns.size() == m*n, "A must be m*n!");
+        factor();
+    }
+
+    // The N*N upper triangular part of R, the rest of R is zero.
+    template<int N>
+    const fixed::Matrix<N, N, T> R() const{
+        assert(N == n, "R must be requested with the column count of A!");
+        fixed::Matrix<N, N, T> result{};
+        for (int _m = 0; _m < N; _m++)
+        {
+            result(_m, _m) = diagonal[_m];
+            for (int _n = _m+1; _n < N; _n++)
+            {
+                result(_m, _n) = columns[_n*m + _m];
+            }
+        }
+        return result;
+    }
+
+    // b = Q^T * b = H(n-1) * ... * H(0) * b
+    void ApplyQTInPlace(ArenaVector<T>& b) const{
+        assert((int)b.size() == m, "b must be as tall as A!");
+        for (int i = 0; i < n; i++)
+        {
+            QRKernels<T>::reflector_update(reflector(i), b.data() + i, m - i, 1, 0);
+        }
+    }
+
+    private:
+    ArenaVector<T> columns;  // Reflectors under and on the diagonal, R above it.
+    ArenaVector<T> diagonal; // Diagonal of R.
+
+    const T* reflector(const int i) const{
+        return columns.data() + i*m + i;
+    }
+
+    void factor(){
+        assert(m >= n, "QR requires at least as many rows as columns!");
+        for (int i = 0; i < n; i++)
+        {
+            factor_column(i);
+        }
+    }
+
+    // Reflects column i onto the diagonal and applies the same reflection to the columns right of it.
+    // The reflector is left in place of the column, all zero if the column is already zero under the diagonal.
+    void factor_column(const int i){
+        T* a = columns.data() + i*m + i;
+        const int length = m - i;
+        const T alpha = sqrt(QRKernels<T>::dot(a, a, length));
+        if (fabs(alpha) < numeric_limits<T>::epsilon()){
+            diagonal[i] = 0;
+            fill(a, a + length, (T)0);
+            return;
+        }
+
+        // w = (a + sign(a0)*|a|*e1) / |...|, so H*a = -sign(a0)*|a|*e1 where H = I - 2*w*w^T.
+        // Adding instead of subtracting avoids cancellation when a is almost parallel to e1.
+        diagonal[i] = -sign(a[0]) * alpha;
+        a[0] -= diagonal[i];
+        QRKernels<T>::scale(a, 1 / sqrt(QRKernels<T>::dot(a, a, length)), a, length);
+
+        // A[i:, i+1:] -= 2 * w * (w^T * A[i:, i+1:])
+        QRKernels<T>::reflector_update(a, a + m, length, n - i - 1, m);
+    }
+};
+
+const HouseholderQR<> QR_decomposition(const Matrix& A){
+    return HouseholderQR<>(A.View());
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Row i of the least squares system for the inner control points.
+// [a b] * [P1 P2]^T = points[i] - c
+template<typename T>
+struct CubicFitRow
+{
+    T a, b;
+    T cx, cy;
+};
+
+template<typename T>
+const CubicFitRow<T> cubic_fit_row(const T ti, const Point P0, const Point P3){
+    const T s = 1 - ti;
+    return {
+        3 * s*s * ti,
+        3 * s * ti*ti,
+        P0.x * s*s*s + P3.x * ti*ti*ti,
+        P0.y * s*s*s + P3.y * ti*ti*ti
+    };
+}
+
+// A * [X Y] = [bx by] for all points, A column major m*2.
+template<typename T>
+struct CubicFitSystem
+{
+    ArenaVector<T> A;
+    ArenaVector<T> bx, by;
+};
+
+template<typename T>
+const CubicFitSystem<T> cubic_fit_system(const PointBuffer& points, const ArenaVector<T>& t){
+    const Point P0 = points.Front();
+    const Point P3 = points.Back();
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    const size_t m = points.Size();
+    CubicFitSystem<T> system{ArenaVector<T>(m * 2), ArenaVector<T>(m), ArenaVector<T>(m)};
+    for (size_t i = 0; i < m; i++)
+    {
+        const CubicFitRow<T> row = cubic_fit_row(t[i], P0, P3);
+        system.A[i] = row.a;
+        system.A[m + i] = row.b;
+        system.bx[i] = x[i] - row.cx;
+        system.by[i] = y[i] - row.cy;
+    }
+    return system;
+}
+
+// R * X = Q^T * bx
+// R * Y = Q^T * by
+// The reflectors are applied to bx and by directly, Q is never formed. bx and by are overwritten.
+template<typename T>
+void solve_householder(const HouseholderQR<T>& QR, ArenaVector<T>& bx, ArenaVector<T>& by, fixed::Vector<2, T>* X, fixed::Vector<2, T>* Y){
+    const fixed::Matrix<2, 2, T> R = QR.template R<2>(); // The 2x2 upper triangular matrix
+
+    QR.ApplyQTInPlace(bx);
+    QR.ApplyQTInPlace(by);
+    const fixed::Vector<2, T> QBx = fixed::Vector<2, T>::FromData(bx.data()); // Discard unnesesery part.
+    const fixed::Vector<2, T> QBy = fixed::Vector<2, T>::FromData(by.data());
+
+    // R * X = QBx => BackSubstitution
+    // R * Y = QBy => BackSubstitution
+    assert(R.IsUpperTriangular(), "R must be upper triangular!");
+    *X = fixed::back_substitution(R, QBx);
+    *Y = fixed::back_substitution(R, QBy);
+}
+
+// A is treated as rank deficient when a diagonal entry of its R is this many epsilons smaller than the other.
+static const double RANK_TOLERANCE_EPSILONS = 1000;
+
+template<typename T>
+bool full_rank(const T r00, const T r11){
+    const T largest = max(fabs(r00), fabs(r11));
+    return largest > 0 && min(fabs(r00), fabs(r11)) > largest * numeric_limits<T>::epsilon() * (T)RANK_TOLERANCE_EPSILONS;
+}
+
+template<typename T>
+bool fit_householder(const PointBuffer& points, const ArenaVector<T>& t, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    CubicFitSystem<T> system = cubic_fit_system(points, t);
+    const HouseholderQR<T> QR(points.Size(), 2, move(system.A));
+    const fixed::Matrix<2, 2, T> R = QR.template R<2>();
+    if (!full_rank(R.Get(0, 0), R.Get(1, 1))) return false;
+
+    fixed::Vector<2, T> _X, _Y;
+    solve_householder(QR, system.bx, system.by, &_X, &_Y);
+    *X = {{ (float)_X.Get(0), (float)_X.Get(1) }};
+    *Y = {{ (float)_Y.Get(0), (float)_Y.Get(1) }};
+    return true;
+}
+
+// Factors A in float, where the SIMD kernels are, then refines the solution with residuals in double:
+// X += argmin |A*dX - (bx - A*X)|, same for Y. Reuses the float factorization for every step.
+bool fit_mixed_precision(const PointBuffer& points, const ArenaVector<double>& t, const int refinement_steps, fixed::Vector<2>* _X, fixed::Vector<2>* _Y){
+    const CubicFitSystem<double> system = cubic_fit_system(points, t);
+    const size_t m = points.Size();
+
+    const HouseholderQR<float> QR(m, 2, ArenaVector<float>(system.A.begin(), system.A.end()));
+    const fixed::Matrix<2, 2> R = QR.R<2>();
+    if (!full_rank(R.Get(0, 0), R.Get(1, 1))) return false;
+
+    ArenaVector<float> rx(system.bx.begin(), system.bx.end());
+    ArenaVector<float> ry(system.by.begin(), system.by.end());
+    fixed::Vector<2, float> dX, dY;
+    solve_householder(QR, rx, ry, &dX, &dY);
+    fixed::Vector<2, double> X = {{ dX.Get(0), dX.Get(1) }};
+    fixed::Vector<2, double> Y = {{ dY.Get(0), dY.Get(1) }};
+
+    for (int step = 0; step < refinement_steps; step++)
+    {
+        for (size_t i = 0; i < m; i++)
+        {
+            const double a = system.A[i], b = system.A[m + i];
+            rx[i] = (float)(system.bx[i] - a*X.Get(0) - b*X.Get(1));
+            ry[i] = (float)(system.by[i] - a*Y.Get(0) - b*Y.Get(1));
+        }
+        solve_householder(QR, rx, ry, &dX, &dY);
+        X = X + fixed::Vector<2, double>{{ dX.Get(0), dX.Get(1) }};
+        Y = Y + fixed::Vector<2, double>{{ dY.Get(0), dY.Get(1) }};
+    }
+
+    *_X = {{ (float)X.Get(0), (float)X.Get(1) }};
+    *_Y = {{ (float)Y.Get(0), (float)Y.Get(1) }};
+    return true;
+}
+
+// Condition number of a symmetric positive semi-definite 2x2 matrix [s00 s01; s01 s11],
+// the ratio of its eigenvalues. Infinite if singular.
+double condition_number_sym2x2(const double s00, const double s01, const double s11){
+    const double mean = (s00 + s11) / 2;
+    const double radius = sqrt((s00 - s11) * (s00 - s11) / 4 + s01 * s01);
+    const double lambda_min = mean - radius;
+    if (lambda_min <= 0) return numeric_limits<double>::infinity();
+    return (mean + radius) / lambda_min;
+}
+
+// A^T*A * [x0 x1]^T = A^T*b, accumulated in double in a single pass over the points.
+// Returns false without touching X and Y if A^T*A is too ill-conditioned to be trusted.
+template<typename T>
+bool fit_normal_equations(const PointBuffer& points, const ArenaVector<T>& t, const double max_condition, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    const Point P0 = points.Front();
+    const Point P3 = points.Back();
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    double s00 = 0, s01 = 0, s11 = 0; // A^T*A
+    double bx0 = 0, bx1 = 0;          // A^T*bx
+    double by0 = 0, by1 = 0;          // A^T*by
+    for (size_t i = 0; i < points.Size(); i++)
+    {
+        const CubicFitRow<T> row = cubic_fit_row(t[i], P0, P3);
+        const double a = row.a, b = row.b;
+        const double rx = x[i] - row.cx;
+        const double ry = y[i] - row.cy;
+
+        s00 += a*a; s01 += a*b; s11 += b*b;
+        bx0 += a*rx; bx1 += b*rx;
+        by0 += a*ry; by1 += b*ry;
+    }
+
+    if (!(condition_number_sym2x2(s00, s01, s11) <= max_condition)) return false;
+
+    // Cramer's rule, the determinant is safely away from 0 after the condition check.
+    const double inv_det = 1 / (s00*s11 - s01*s01);
+    *X = {{ (float)((s11*bx0 - s01*bx1) * inv_det), (float)((s00*bx1 - s01*bx0) * inv_det) }};
+    *Y = {{ (float)((s11*by0 - s01*by1) * inv_det), (float)((s00*by1 - s01*by0) * inv_det) }};
+    return true;
+}
+
+void givens_update(double* R, double* row, const int n);
+
+// Every row [a b rx ry] is rotated into a 4x4 triangle as it is built, in double.
+// Nothing but the triangle is stored, and R * [X Y] = Q^T * [bx by] is read off its top two rows.
+template<typename T>
+bool fit_givens(const PointBuffer& points, const ArenaVector<T>& t, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    const Point P0 = points.Front();
+    const Point P3 = points.Back();
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    double R[4 * 4] = {0};
+    for (size_t i = 0; i < points.Size(); i++)
+    {
+        const CubicFitRow<T> row = cubic_fit_row(t[i], P0, P3);
+        double r[4] = {(double)row.a, (double)row.b, x[i] - (double)row.cx, y[i] - (double)row.cy};
+        givens_update(R, r, 4);
+    }
+    if (!full_rank(R[0], R[5])) return false;
+
+    const double X1 = R[6] / R[5], Y1 = R[7] / R[5];
+    *X = {{ (float)((R[2] - R[1] * X1) / R[0]), (float)X1 }};
+    *Y = {{ (float)((R[3] - R[1] * Y1) / R[0]), (float)Y1 }};
+    return true;
+}
+
+// Singular values smaller than this relative to the largest are dropped by the SVD.
+static const double SVD_RANK_TOLERANCE = 1e-10;
+
+// One-sided Jacobi SVD in double: A*V = U*S, the two columns of A are made orthogonal by a plane rotation,
+// a second sweep only mops up rounding. Rank deficient A (3 points, repeated points) is solved for
+// the smallest change from the straight line Bezier, P1 and P2 at the thirds of P0-P3, instead of failing.
+template<typename T>
+bool fit_svd(const PointBuffer& points, const ArenaVector<T>& t, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    const Point P0 = points.Front();
+    const Point P3 = points.Back();
+    const Point line1 = P0 + (P3 - P0) * (1.0f / 3), line2 = P0 + (P3 - P0) * (2.0f / 3);
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    const size_t m = points.Size();
+    ArenaVector<double> u(m), v(m), rx(m), ry(m);
+    for (size_t i = 0; i < m; i++)
+    {
+        const CubicFitRow<T> row = cubic_fit_row(t[i], P0, P3);
+        u[i] = row.a;
+        v[i] = row.b;
+        rx[i] = x[i] - (double)row.cx - u[i] * line1.x - v[i] * line2.x;
+        ry[i] = y[i] - (double)row.cy - u[i] * line1.y - v[i] * line2.y;
+    }
+
+    double V[2][2] = {{1, 0}, {0, 1}};
+    for (int sweep = 0; sweep < 2; sweep++)
+    {
+        double alpha = 0, beta = 0, gamma = 0;
+        for (size_t i = 0; i < m; i++) { alpha += u[i]*u[i]; beta += v[i]*v[i]; gamma += u[i]*v[i]; }
+        if (fabs(gamma) <= numeric_limits<double>::epsilon() * sqrt(alpha * beta)) break;
+
+        // Rotation that zeroes gamma, the smaller of the two angles.
+        const double zeta = (beta - alpha) / (2 * gamma);
+        const double tangent = (zeta >= 0 ? 1 : -1) / (fabs(zeta) + sqrt(1 + zeta*zeta));
+        const double c = 1 / sqrt(1 + tangent*tangent), s = c * tangent;
+        for (size_t i = 0; i < m; i++)
+        {
+            const double ui = u[i], vi = v[i];
+            u[i] = c*ui - s*vi;
+            v[i] = s*ui + c*vi;
+        }
+        for (int r = 0; r < 2; r++)
+        {
+            const double v0 = V[r][0], v1 = V[r][1];
+            V[r][0] = c*v0 - s*v1;
+            V[r][1] = s*v0 + c*v1;
+        }
+    }
+
+    // Columns of A*V are S*U, so U^T*b / S = (A*V)^T*b / S^2.
+    double squared[2] = {0, 0}, ux = 0, uy = 0, vx = 0, vy = 0;
+    for (size_t i = 0; i < m; i++)
+    {
+        squared[0] += u[i]*u[i]; squared[1] += v[i]*v[i];
+        ux += u[i]*rx[i]; uy += u[i]*ry[i];
+        vx += v[i]*rx[i]; vy += v[i]*ry[i];
+    }
+    const double cutoff = max(squared[0], squared[1]) * SVD_RANK_TOLERANCE * SVD_RANK_TOLERANCE;
+    const double cx[2] = {squared[0] > cutoff ? ux / squared[0] : 0, squared[1] > cutoff ? vx / squared[1] : 0};
+    const double cy[2] = {squared[0] > cutoff ? uy / squared[0] : 0, squared[1] > cutoff ? vy / squared[1] : 0};
+
+    *X = {{ (float)(line1.x + V[0][0]*cx[0] + V[0][1]*cx[1]), (float)(line2.x + V[1][0]*cx[0] + V[1][1]*cx[1]) }};
+    *Y = {{ (float)(line1.y + V[0][0]*cy[0] + V[0][1]*cy[1]), (float)(line2.y + V[1][0]*cy[0] + V[1][1]*cy[1]) }};
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// A backend of the inner control point solve, min |A*[X Y] - [bx by]| given the chord lengths.
+// solve returns false, leaving X and Y alone, when its answer cannot be trusted on this system.
+template<typename T>
+struct LeastSquaresSolver
+{
+    FitSolver kind;
+    bool (*solve)(const PointBuffer& points, const ArenaVector<T>& t, const FitOptions& options, fixed::Vector<2>* X, fixed::Vector<2>* Y);
+};
+
+template<typename T>
+bool least_squares_normal_equations(const PointBuffer& points, const ArenaVector<T>& t, const FitOptions& options, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    return fit_normal_equations(points, t, options.normal_equations_max_condition, X, Y);
+}
+
+template<typename T>
+bool least_squares_householder(const PointBuffer& points, const ArenaVector<T>& t, const FitOptions& options, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    if constexpr (is_same<T, double>::value){
+        if (options.precision == FitPrecision::Mixed) return fit_mixed_precision(points, t, options.refinement_steps, X, Y);
+    }
+    return fit_householder(points, t, X, Y);
+}
+
+template<typename T>
+bool least_squares_givens(const PointBuffer& points, const ArenaVector<T>& t, const FitOptions&, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    return fit_givens(points, t, X, Y);
+}
+
+template<typename T>
+bool least_squares_svd(const PointBuffer& points, const ArenaVector<T>& t, const FitOptions&, fixed::Vector<2>* X, fixed::Vector<2>* Y){
+    return fit_svd(points, t, X, Y);
+}
+
+// Indexed by FitSolver, Auto excluded.
+template<typename T>
+const LeastSquaresSolver<T>& least_squares_solver(const FitSolver kind){
+    static const LeastSquaresSolver<T> solvers[] = {
+        {FitSolver::NormalEquations, least_squares_normal_equations<T>},
+        {FitSolver::Householder, least_squares_householder<T>},
+        {FitSolver::Givens, least_squares_givens<T>},
+        {FitSolver::SVD, least_squares_svd<T>},
+    };
+    assert(kind != FitSolver::Auto, "Auto has to be resolved to a backend first!");
+    return solvers[(int)kind];
+}
+
+const char* FitSolverName(const FitSolver kind){
+    switch (kind)
+    {
+        case FitSolver::NormalEquations: return "normal";
+        case FitSolver::Householder: return "householder";
+        case FitSolver::Givens: return "givens";
+        case FitSolver::SVD: return "svd";
+        case FitSolver::Auto: return "auto";
+    }
+    return "unknown";
+}
+
+// Point counts the auto tuner times. A stroke uses the entry of the largest count not above its own.
+static const int SOLVER_TUNING_POINTS[] = {8, 32, 128, 512, 2048, 8192};
+static const int SOLVER_TUNING_SIZE = sizeof(SOLVER_TUNING_POINTS) / sizeof(SOLVER_TUNING_POINTS[0]);
+
+// Points timed per backend and count, enough to be above timer noise and still only take milliseconds.
+static const int SOLVER_TUNING_WORK = 32768;
+
+// FitSolver::Auto's pick of the fastest backend per point count and precision, timed once on this machine by
+// TuneFitSolvers, or else by the first fit that needs it. T is the scalar type of t, Mixed runs on double t.
+// The CF_SOLVER environment variable (normal, householder, givens or svd) replaces the timings with one backend.
+template<typename T>
+struct SolverDispatch
+{
+    FitSolver fastest[SOLVER_TUNING_SIZE];
+    bool overridden = false;
+
+    explicit SolverDispatch(const FitPrecision precision){
+        if (const char* name = getenv("CF_SOLVER")) {
+            for (FitSolver kind : {FitSolver::NormalEquations, FitSolver::Householder, FitSolver::Givens, FitSolver::SVD})
+            {
+                if (strcmp(name, FitSolverName(kind)) != 0) continue;
+                fill(fastest, fastest + SOLVER_TUNING_SIZE, kind);
+                overridden = true;
+                return;
+            }
+        }
+        Tune(precision);
+    }
+
+    FitSolver For(const size_t points) const{
+        int i = 0;
+        while (i + 1 < SOLVER_TUNING_SIZE && (size_t)SOLVER_TUNING_POINTS[i+1] <= points) i++;
+        return fastest[i];
+    }
+
+private:
+    void Tune(const FitPrecision precision){
+        FitOptions options;
+        options.precision = precision;
+
+        for (int i = 0; i < SOLVER_TUNING_SIZE; i++)
+        {
+            const int count = SOLVER_TUNING_POINTS[i];
+            PointBuffer points;
+            points.Reserve(count);
+            for (int j = 0; j < count; j++)
+            {
+                const float s = j / (float)(count - 1);
+                points.PushBack(Point(100 * s + 10 * sinf(s * 5), 40 * s*s + 10 * cosf(s * 3)));
+            }
+            ArenaScope scratch;
+            const ArenaVector<T> t(chord_lenght_parameterize<T>(points));
+            const int repetitions = max(4, SOLVER_TUNING_WORK / count);
+
+            double best = numeric_limits<double>::infinity();
+            for (FitSolver kind : {FitSolver::NormalEquations, FitSolver::Householder, FitSolver::Givens, FitSolver::SVD})
+            {
+                const LeastSquaresSolver<T>& solver = least_squares_solver<T>(kind);
+                fixed::Vector<2> X, Y;
+                solver.solve(points, t, options, &X, &Y); // Warm up
+
+                const auto start = chrono::steady_clock::now();
+                for (int r = 0; r < repetitions; r++) solver.solve(points, t, options, &X, &Y);
+                const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                if (seconds < best) {
+                    best = seconds;
+                    fastest[i] = kind;
+                }
+            }
+        }
+    }
+};
+
+// Mixed has a table of its own, its Householder is a float QR plus refinement in double, neither of the others.
+template<typename T>
+const SolverDispatch<T>& solver_dispatch(const FitPrecision precision){
+    if (precision == FitPrecision::Mixed) {
+        static const SolverDispatch<T> mixed(FitPrecision::Mixed);
+        return mixed;
+    }
+    static const SolverDispatch<T> dispatch(is_same<T, float>::value ? FitPrecision::Float : FitPrecision::Double);
+    return dispatch;
+}
+
+FitSolver AutoFitSolver(const size_t points, const FitPrecision precision){
+    if (precision == FitPrecision::Float) return solver_dispatch<float>(precision).For(points);
+    return solver_dispatch<double>(precision).For(points);
+}
+
+void TuneFitSolvers(){
+    solver_dispatch<float>(FitPrecision::Float);
+    solver_dispatch<double>(FitPrecision::Double);
+    solver_dispatch<double>(FitPrecision::Mixed);
+}
+
+// T is the scalar type of t and the QR.
+// The chosen backend first, then QR if it declines, then the SVD, which never does.
+template<typename T>
+const Bezier fit_with_parameters(const PointBuffer& points, const ArenaVector<T>& t, const FitOptions& options){
+    const FitSolver first = options.solver == FitSolver::Auto ? solver_dispatch<T>(options.precision).For(points.Size()) : options.solver;
+    fixed::Vector<2> X, Y;
+    if (!least_squares_solver<T>(first).solve(points, t, options, &X, &Y)) {
+        // A backend that declined once would decline again, so the chain skips it.
+        if (first == FitSolver::Householder || !least_squares_solver<T>(FitSolver::Householder).solve(points, t, options, &X, &Y)) {
+            if (first != FitSolver::SVD) least_squares_solver<T>(FitSolver::SVD).solve(points, t, options, &X, &Y);
+        }
+    }
+    return Bezier(points.Front(), Point(X.Get(0), Y.Get(0)), Point(X.Get(1), Y.Get(1)), points.Back());
+}
+
+// Sum of the distances of every point from the curve at its t.
+// BezierCubic spelled out over the x and y arrays, so the loop vectorizes.
+double bezier_error(const Bezier& b, const PointBuffer& points, const float* t){
+    const float* x = points.X();
+    const float* y = points.Y();
+    double accumulated_error = 0;
+    for (size_t i = 0; i < points.Size(); i++)
+    {
+        const float ti = t[i], s = 1 - ti;
+        const float w0 = s*s*s, w1 = 3*s*s*ti, w2 = 3*s*ti*ti, w3 = ti*ti*ti;
+        const float dx = b.P0.x*w0 + b.P1.x*w1 + b.P2.x*w2 + b.P3.x*w3 - x[i];
+        const float dy = b.P0.y*w0 + b.P1.y*w1 + b.P2.y*w2 + b.P3.y*w3 - y[i];
+        accumulated_error += (double)sqrtf(dx*dx + dy*dy);
+    }
+    return accumulated_error;
+}
+
+// Newton-Raphson passes over t: every t moves towards the closest point of the current curve, then the curve
+// is fitted again with the new t. Stops when the error at t improves by less than reparameterize_min_improvement,
+// gets worse, or the iterations or the time budget run out. The steps run on float t in the SIMD kernel.
+template<typename T>
+const Bezier reparameterize(const PointBuffer& points, Bezier bezier, const ArenaVector<T>& chord_t, const FitOptions& options){
+    const size_t m = points.Size();
+    ArenaVector<float> t(chord_t.begin(), chord_t.end());
+    ArenaVector<T> fit_t(m);
+    double error = bezier_error(bezier, points, t.data());
+    if (options.report != nullptr) options.report->chord_error = error;
+
+    const SimdKernels& simd = Simd();
+    const auto start = chrono::steady_clock::now();
+    for (int iteration = 0; iteration < options.reparameterize_iterations; iteration++)
+    {
+        const auto iteration_start = chrono::steady_clock::now();
+        const float control[8] = {bezier.P0.x, bezier.P0.y, bezier.P1.x, bezier.P1.y, bezier.P2.x, bezier.P2.y, bezier.P3.x, bezier.P3.y};
+        simd.bezier_newton(control, points.X(), points.Y(), t.data(), m);
+
+        copy(t.begin(), t.end(), fit_t.begin());
+        const Bezier candidate = fit_with_parameters(points, fit_t, options);
+        const double candidate_error = bezier_error(candidate, points, t.data());
+
+        const auto now = chrono::steady_clock::now();
+        if (options.report != nullptr)
+            options.report->iterations.push_back({candidate_error, chrono::duration<double, micro>(now - iteration_start).count()});
+
+        if (!(candidate_error < error)) break; // The previous curve stays
+        const double improvement = (error - candidate_error) / error;
+        bezier = candidate;
+        error = candidate_error;
+        if (improvement < options.reparameterize_min_improvement) break;
+        if (options.reparameterize_budget_us > 0 && chrono::duration<double, micro>(now - start).count() >= options.reparameterize_budget_us) break;
+    }
+    return bezier;
+}
+
+template<typename T>
+const Bezier fit_cubic_bezier(const PointBuffer& points, const FitOptions& options){
+    const ArenaVector<T> t(chord_lenght_parameterize<T>(points));
+    const Bezier bezier = fit_with_parameters(points, t, options);
+    if (options.reparameterize_iterations > 0) return reparameterize(points, bezier, t, options);
+    return bezier;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// R of the augmented system [A | bx | by]. The top left 2x2 is R of A, rows 0 and 1 of the last two
+// columns are Q^T*bx and Q^T*by, which is all the solve needs.
+typedef fixed::Matrix<4, 4, double> AugmentedR;
+
+// Rows of [A | bx | by] factored at a time by a TSQR thread, bounds its scratch to a few hundred KB.
+static const int TSQR_CHUNK_ROWS = 4096;
+
+// R of [top; block], block is column major rows*4, column k starts at block + k*rows.
+const AugmentedR stacked_r(const AugmentedR& top, const double* block, const int rows){
+    const int m = 4 + rows;
+    ArenaVector<double> stacked(m * 4);
+    for (int k = 0; k < 4; k++)
+    {
+        for (int i = 0; i < 4; i++) stacked[k*m + i] = top.Get(i, k);
+        copy(block + k*rows, block + (k+1)*rows, stacked.begin() + k*m + 4);
+    }
+    return HouseholderQR<double>(m, 4, move(stacked)).R<4>();
+}
+
+// R of the rows [first, last) of the fit, folded TSQR_CHUNK_ROWS at a time: each chunk is factored with the R so far on top.
+const AugmentedR tsqr_local(const PointBuffer& points, const ArenaVector<float>& t, const size_t first, const size_t last){
+    const Point P0 = points.Front();
+    const Point P3 = points.Back();
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    AugmentedR R{}; // Zero rows on top of the first chunk change nothing
+    for (size_t begin = first; begin < last; begin += TSQR_CHUNK_ROWS)
+    {
+        ArenaScope chunk_scratch;
+        const int rows = (int)min((size_t)TSQR_CHUNK_ROWS, last - begin);
+        ArenaVector<double> block(rows * 4);
+        for (int i = 0; i < rows; i++)
+        {
+            const CubicFitRow<double> row = cubic_fit_row((double)t[begin + i], P0, P3);
+            block[i] = row.a;
+            block[rows + i] = row.b;
+            block[2*rows + i] = x[begin + i] - row.cx;
+            block[3*rows + i] = y[begin + i] - row.cy;
+        }
+        R = stacked_r(R, block.data(), rows);
+    }
+    return R;
+}
+
+// Tall skinny QR across the shared pool. Every task reduces a contiguous range of rows to a 4x4 R in the arena
+// of the thread running it, the R factors are then merged pairwise up a binary tree. Local QRs run in double.
+const Bezier fit_tsqr(const PointBuffer& points, const FitOptions& options){
+    const ArenaVector<float> t(chord_lenght_parameterize(points));
+    const size_t m = points.Size();
+
+    TaskPool& pool = TaskPool::Shared();
+    const size_t max_threads = options.threads > 0 ? options.threads : pool.Threads() + 1;
+    // Every task gets at least a full chunk.
+    const int threads = (int)max((size_t)1, min(max_threads, m / TSQR_CHUNK_ROWS));
+
+    vector<AugmentedR> partial(threads);
+    TaskGroup group;
+    for (int i = 0; i < threads; i++)
+    {
+        const size_t first = m * i / threads, last = m * (i+1) / threads;
+        const auto work = [&, i, first, last](){
+            ArenaScope scratch;
+            partial[i] = tsqr_local(points, t, first, last);
+        };
+        // The calling thread takes the last range itself.
+        if (i + 1 < threads) pool.Submit(group, work);
+        else work();
+    }
+    pool.Wait(group);
+
+    for (int stride = 1; stride < threads; stride *= 2)
+    {
+        for (int i = 0; i + stride < threads; i += 2*stride)
+        {
+            const AugmentedR& bottom = partial[i + stride];
+            double block[16];
+            for (int k = 0; k < 4; k++)
+            {
+                for (int j = 0; j < 4; j++) block[k*4 + j] = bottom.Get(j, k);
+            }
+            partial[i] = stacked_r(partial[i], block, 4);
+        }
+    }
+
+    // Rank deficient, mostly repeated points: the SVD, as every other backend hands it on.
+    const AugmentedR& R = partial[0];
+    if (!full_rank(R.Get(0, 0), R.Get(1, 1))) {
+        fixed::Vector<2> X, Y;
+        fit_svd(points, t, &X, &Y);
+        return Bezier(points.Front(), Point(X.Get(0), Y.Get(0)), Point(X.Get(1), Y.Get(1)), points.Back());
+    }
+    const fixed::Matrix<2, 2, double> RA = {{ R.Get(0, 0), R.Get(0, 1), 0, R.Get(1, 1) }};
+    const fixed::Vector<2, double> X = fixed::back_substitution(RA, fixed::Vector<2, double>{{ R.Get(0, 2), R.Get(1, 2) }});
+    const fixed::Vector<2, double> Y = fixed::back_substitution(RA, fixed::Vector<2, double>{{ R.Get(0, 3), R.Get(1, 3) }});
+
+    return Bezier(points.Front(), Point((float)X.Get(0), (float)Y.Get(0)), Point((float)X.Get(1), (float)Y.Get(1)), points.Back());
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Pseudo-inverse of the cubic fit on count points evenly spaced in t, t[i] = i / (count-1).
+// With P0 translated to the origin b = p - P3 * t^3, so [X Y] = pinv * p - P3 * (pinv * t^3).
+struct ResampledFitTable
+{
+    int count = 0;
+    const float* pinv = nullptr; // 2 rows of count, row major
+    float P3_weights[2] = {};
+};
+
+// Fills storage (2*count floats) and returns the table pointing into it. Built in double, only stored in float.
+const ResampledFitTable build_resampled_fit_table(const int count, float* storage){
+    assert(count >= 4, "Resampling needs at least 4 points for a cubic fit!");
+
+    double s00 = 0, s01 = 0, s11 = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const CubicFitRow<double> row = cubic_fit_row((double)i / (count - 1), Point(), Point());
+        s00 += row.a*row.a; s01 += row.a*row.b; s11 += row.b*row.b;
+    }
+    const double inv_det = 1 / (s00*s11 - s01*s01);
+
+    ResampledFitTable table;
+    table.count = count;
+    table.pinv = storage;
+    double w0 = 0, w1 = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const double ti = (double)i / (count - 1);
+        const CubicFitRow<double> row = cubic_fit_row(ti, Point(), Point());
+        const double p0 = (s11*row.a - s01*row.b) * inv_det;
+        const double p1 = (s00*row.b - s01*row.a) * inv_det;
+        storage[i] = (float)p0;
+        storage[count + i] = (float)p1;
+        w0 += p0 * ti*ti*ti;
+        w1 += p1 * ti*ti*ti;
+    }
+    table.P3_weights[0] = (float)w0;
+    table.P3_weights[1] = (float)w1;
+    return table;
+}
+
+// Tables of the common counts are built once, on first use.
+static const int RESAMPLED_FIT_TABLE_COUNTS[] = {16, 32, 64, 128, 256};
+
+struct ResampledFitTables
+{
+    static const int SIZE = sizeof(RESAMPLED_FIT_TABLE_COUNTS) / sizeof(RESAMPLED_FIT_TABLE_COUNTS[0]);
+
+    vector<float> storage;
+    ResampledFitTable tables[SIZE];
+
+    ResampledFitTables(){
+        size_t total = 0;
+        for (int count : RESAMPLED_FIT_TABLE_COUNTS) total += 2 * count;
+        storage.resize(total);
+
+        float* next = storage.data();
+        for (int i = 0; i < SIZE; i++)
+        {
+            tables[i] = build_resampled_fit_table(RESAMPLED_FIT_TABLE_COUNTS[i], next);
+            next += 2 * RESAMPLED_FIT_TABLE_COUNTS[i];
+        }
+    }
+
+    const ResampledFitTable* Find(const int count) const{
+        for (const ResampledFitTable& table : tables)
+        {
+            if (table.count == count) return &table;
+        }
+        return nullptr;
+    }
+};
+
+// Table for count from the cache, uncommon counts are built into storage, which must outlive the table.
+const ResampledFitTable resampled_fit_table(const int count, ArenaVector<float>& storage){
+    static const ResampledFitTables cache;
+    if (const ResampledFitTable* table = cache.Find(count)) return *table;
+
+    storage.resize(2 * count);
+    return build_resampled_fit_table(count, storage.data());
+}
+
+// count points evenly spaced along the polyline into x and y, translated so the first point is the origin.
+void resample_stroke(const PointBuffer& points, const int count, float* x, float* y){
+    ArenaVector<float> t(points.Size());
+    chord_lenght_parameterize_into(points, t.data());
+
+    const float* px = points.X();
+    const float* py = points.Y();
+    const float x0 = px[0], y0 = py[0];
+    size_t j = 0;
+    for (int k = 0; k < count; k++)
+    {
+        const float target = (float)k / (count - 1);
+        while (j + 2 < points.Size() && t[j+1] < target) j++;
+
+        const float span = t[j+1] - t[j];
+        const float f = span > 0 ? fmin(fmax((target - t[j]) / span, 0.0f), 1.0f) : 0;
+        x[k] = px[j] + (px[j+1] - px[j]) * f - x0;
+        y[k] = py[j] + (py[j+1] - py[j]) * f - y0;
+    }
+    x[count - 1] = px[points.Size() - 1] - x0;
+    y[count - 1] = py[points.Size() - 1] - y0;
+}
+
+// Resampled to count points, the fit is two dot products per axis with the cached pseudo-inverse.
+const Bezier fit_resampled(const PointBuffer& points, const int count){
+    ArenaVector<float> storage;
+    const ResampledFitTable table = resampled_fit_table(count, storage);
+    ArenaVector<float> x(count), y(count);
+    resample_stroke(points, count, x.data(), y.data());
+
+    const SimdKernels& simd = Simd();
+    const Point P0 = points.Front();
+    const Point P3 = points.Back() - P0;
+    const float* pinv1 = table.pinv + count;
+    const Point P1(simd.dot(table.pinv, x.data(), count) - P3.x * table.P3_weights[0],
+                   simd.dot(table.pinv, y.data(), count) - P3.y * table.P3_weights[0]);
+    const Point P2(simd.dot(pinv1, x.data(), count) - P3.x * table.P3_weights[1],
+                   simd.dot(pinv1, y.data(), count) - P3.y * table.P3_weights[1]);
+    return Bezier(P0, P1 + P0, P2 + P0, points.Back());
+}
+
+const Bezier FitCubicBezier(const PointBuffer& points, const FitOptions& options){
+    assert(points.Size() >= 2, "Not enough points to fit cubic bezier!");
+    ArenaScope scratch;
+
+    if (points.Size() == 2)
+        return Bezier(points[0],points[0],points[1],points[1]);
+
+    if (options.resample_count >= 4) return fit_resampled(points, options.resample_count);
+    if (points.Size() >= options.parallel_min_points) return fit_tsqr(points, options);
+
+    if (options.precision == FitPrecision::Float) return fit_cubic_bezier<float>(points, options);
+    return fit_cubic_bezier<double>(points, options);
+}
+
+// SoA copy of points for the vector<Point> entry points, the same buffer is reused by every call on the thread.
+const PointBuffer& packed(const vector<Point>& points){
+    thread_local PointBuffer buffer;
+    buffer.Assign(points);
+    return buffer;
+}
+
+const Bezier FitCubicBezier(const vector<Point>& points, const FitOptions& options){
+    // The TSQR waits on the pool, and the tasks the waiting thread runs meanwhile may pack points of their own.
+    if (points.size() >= options.parallel_min_points) {
+        PointBuffer own;
+        own.Assign(points);
+        return FitCubicBezier(own, options);
+    }
+    return FitCubicBezier(packed(points), options);
+}
+
+//------------------------------------------------------------------------------------------------
+
+// The lanes accumulate in float, so they are trusted with less than FitOptions::normal_equations_max_condition.
+static const double BATCH_MAX_CONDITION = 1e5;
+
+// Strokes are sorted by length and packed FIT_BATCH_LANES at a time into SoA buffers, translated to their first point,
+// so one kernel call sets up the normal equations of a whole group. Each lane is then solved in double.
+// Lanes that are too short or ill-conditioned are refitted one by one with FitCubicBezier.
+const vector<Bezier> fit_batch(const SimdKernels& kernels, const vector<vector<Point>>& strokes, const FitOptions& options){
+    const int L = FIT_BATCH_LANES;
+    const double max_condition = min(BATCH_MAX_CONDITION, options.normal_equations_max_condition);
+    ArenaScope scratch;
+
+    // Similar lengths share a group, so little of it is padding.
+    // Sorted as (length << 32 | index) keys, plain integers sort much faster than an indirect comparison.
+    ArenaVector<uint64_t> keys(strokes.size());
+    for (size_t i = 0; i < strokes.size(); i++) keys[i] = (uint64_t)strokes[i].size() << 32 | i;
+    sort(keys.begin(), keys.end());
+    ArenaVector<size_t> order(strokes.size());
+    for (size_t i = 0; i < strokes.size(); i++) order[i] = (size_t)(keys[i] & 0xFFFFFFFF);
+
+    vector<Bezier> result(strokes.size());
+    ArenaVector<bool> solved(strokes.size(), false);
+    // Sized for the longest stroke up front, growing would leave every smaller buffer behind in the arena.
+    const size_t longest = strokes.empty() ? 0 : strokes[order.back()].size();
+    vec x(longest * L), y(longest * L);
+    vec sums(FIT_BATCH_SUMS * L);
+    int count[FIT_BATCH_LANES];
+
+    for (size_t group = 0; group < strokes.size(); group += L)
+    {
+        const int lanes = (int)min((size_t)L, strokes.size() - group);
+        const size_t max_count = strokes[order[group + lanes - 1]].size();
+
+        x.assign(max_count * L, 0);
+        y.assign(max_count * L, 0);
+        for (int lane = 0; lane < L; lane++)
+        {
+            count[lane] = 0;
+            if (lane >= lanes) continue;
+            const vector<Point>& stroke = strokes[order[group + lane]];
+            count[lane] = (int)stroke.size();
+            for (size_t i = 0; i < stroke.size(); i++)
+            {
+                x[i*L + lane] = stroke[i].x - stroke[0].x;
+                y[i*L + lane] = stroke[i].y - stroke[0].y;
+            }
+        }
+
+        kernels.fit_batch(x.data(), y.data(), count, max_count, sums.data());
+
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            if (count[lane] < 3) continue;
+            const double s00 = sums[0*L + lane], s01 = sums[1*L + lane], s11 = sums[2*L + lane];
+            const double bx0 = sums[3*L + lane], bx1 = sums[4*L + lane];
+            const double by0 = sums[5*L + lane], by1 = sums[6*L + lane];
+            if (!(condition_number_sym2x2(s00, s01, s11) <= max_condition)) continue;
+
+            // Same Cramer's rule as fit_normal_equations, then back from the translated frame.
+            const size_t index = order[group + lane];
+            const Point P0 = strokes[index].front();
+            const double inv_det = 1 / (s00*s11 - s01*s01);
+            const Point P1 = P0 + Point((float)((s11*bx0 - s01*bx1) * inv_det), (float)((s11*by0 - s01*by1) * inv_det));
+            const Point P2 = P0 + Point((float)((s00*bx1 - s01*bx0) * inv_det), (float)((s00*by1 - s01*by0) * inv_det));
+            result[index] = Bezier(P0, P1, P2, strokes[index].back());
+            solved[index] = true;
+        }
+    }
+
+    for (size_t i = 0; i < strokes.size(); i++)
+    {
+        if (!solved[i]) result[i] = FitCubicBezier(strokes[i], options);
+    }
+    return result;
+}
+
+const vector<Bezier> FitCubicBezierBatch(const vector<vector<Point>>& strokes, const FitOptions& options){
+    // The lanes are float normal equations, anything else is fitted stroke by stroke.
+    const bool normal_equations = options.solver == FitSolver::NormalEquations || options.solver == FitSolver::Auto;
+    if (!normal_equations || options.precision != FitPrecision::Float || options.resample_count >= 4 || options.reparameterize_iterations > 0) {
+        vector<Bezier> result;
+        result.reserve(strokes.size());
+        for (const vector<Point>& stroke : strokes) result.push_back(FitCubicBezier(stroke, options));
+        return result;
+    }
+    return fit_batch(Simd(), strokes, options);
+}
+
+//------------------------------------------------------------------------------------------------
+
+// The spline is a uniform cubic B-spline over u = t * segments, control points Q(0) .. Q(segments+2).
+// Segment j is weighted by Q(j) .. Q(j+3) and is C2 with its neighbours by construction.
+// The ends are pinned to the stroke by eliminating Q(0) = 6*P0 - 4*Q(1) - Q(2), same for the last,
+// which leaves Q(1) .. Q(segments+1) as unknowns and keeps the band intact.
+
+// Uniform cubic B-spline weights of Q(j) .. Q(j+3) at v in [0, 1] of segment j.
+void bspline_weights(const double v, double* w){
+    const double v2 = v*v, v3 = v2*v;
+    w[0] = (1 - 3*v + 3*v2 - v3) / 6;
+    w[1] = (3*v3 - 6*v2 + 4) / 6;
+    w[2] = (-3*v3 + 3*v2 + 3*v + 1) / 6;
+    w[3] = v3 / 6;
+}
+
+// Second difference penalty on the control points, relative to the mean diagonal.
+// Only there so segments without any points still have a unique solution.
+static const double SPLINE_SMOOTHING = 1e-9;
+
+// Half bandwidth of A^T*A, a row touches 4 neighbouring control points.
+static const int SPLINE_BANDWIDTH = 3;
+
+const vector<Bezier> FitCubicSpline(const PointBuffer& points, const int segments){
+    assert(points.Size() >= 2, "Not enough points to fit a spline!");
+    assert(segments >= 1, "A spline needs at least one segment!");
+    if (points.Size() == 2) return {Bezier(points[0], points[0], points[1], points[1])};
+    ArenaScope scratch;
+
+    const ArenaVector<double> t(chord_lenght_parameterize<double>(points));
+    const Point P0 = points.Front();
+    const Point P3 = points.Back();
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    // Unknown c is Q(c+1). Normal equations accumulated in double straight into the band.
+    const int n = segments + 1;
+    BandedMatrix AtA(n, SPLINE_BANDWIDTH);
+    ArenaVector<double> bx(n, 0.0), by(n, 0.0);
+    for (size_t i = 0; i < points.Size(); i++)
+    {
+        const double u = t[i] * segments;
+        const int j = min((int)u, segments - 1);
+        double w[4];
+        bspline_weights(u - j, w);
+
+        // Right hand side less the pinned ends. Relative to P0 the first end adds nothing to it.
+        double rx = x[i] - P0.x, ry = y[i] - P0.y;
+        if (j == 0) {
+            w[1] -= 4 * w[0]; w[2] -= w[0];
+        }
+        if (j == segments - 1) {
+            w[2] -= 4 * w[3]; w[1] -= w[3];
+            rx -= 6 * (P3.x - P0.x) * w[3];
+            ry -= 6 * (P3.y - P0.y) * w[3];
+        }
+
+        // Q(j) .. Q(j+3) are unknowns j-1 .. j+2, the eliminated ends fall outside.
+        for (int a = 0; a < 4; a++)
+        {
+            const int ca = j - 1 + a;
+            if (ca < 0 || ca >= n) continue;
+            bx[ca] += w[a] * rx;
+            by[ca] += w[a] * ry;
+            for (int b = 0; b <= a; b++)
+            {
+                const int cb = j - 1 + b;
+                if (cb < 0) continue;
+                AtA(ca, cb) += w[a] * w[b];
+            }
+        }
+    }
+
+    double trace = 0;
+    for (int c = 0; c < n; c++) trace += AtA.Get(c, c);
+    const double lambda = SPLINE_SMOOTHING * trace / n;
+    for (int c = 1; c + 1 < n; c++)
+    {
+        // lambda * |Q(c-1) - 2*Q(c) + Q(c+1)|^2
+        const int cs[3] = {c-1, c, c+1};
+        const double d[3] = {1, -2, 1};
+        for (int a = 0; a < 3; a++)
+        {
+            for (int b = 0; b <= a; b++) AtA(cs[a], cs[b]) += lambda * d[a] * d[b];
+        }
+    }
+
+    const bool factored = AtA.Cholesky();
+    assert(factored, "Spline normal equations are not positive definite!");
+    AtA.SolveInPlace(bx.data());
+    AtA.SolveInPlace(by.data());
+
+    // All control points including the eliminated ends, back in stroke coordinates.
+    ArenaVector<Point> Q(segments + 3);
+    for (int c = 0; c < n; c++) Q[c+1] = Point((float)bx[c], (float)by[c]) + P0;
+    Q[0] = P0 * 6 - Q[1] * 4 - Q[2];
+    Q[segments+2] = P3 * 6 - Q[segments+1] * 4 - Q[segments];
+
+    // B-spline to Bezier, segment by segment.
+    vector<Bezier> result;
+    result.reserve(segments);
+    for (int j = 0; j < segments; j++)
+    {
+        const Point& q0 = Q[j]; const Point& q1 = Q[j+1]; const Point& q2 = Q[j+2]; const Point& q3 = Q[j+3];
+        result.push_back(Bezier(
+            (q0 + q1 * 4 + q2) * (1.0f / 6),
+            (q1 * 2 + q2) * (1.0f / 3),
+            (q1 + q2 * 2) * (1.0f / 3),
+            (q1 + q2 * 4 + q3) * (1.0f / 6)));
+    }
+    // Exactly on the stroke, not just up to rounding.
+    result.front().P0 = P0;
+    result.back().P3 = P3;
+    return result;
+}
+
+const vector<Bezier> FitCubicSpline(const vector<Point>& points, const int segments){
+    return FitCubicSpline(packed(points), segments);
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Rotates row into the n*n upper triangular R (row major) with Givens rotations.
+// Afterwards R^T*R includes row*row^T, row is left holding garbage.
+void givens_update(double* R, double* row, const int n){
+    for (int j = 0; j < n; j++)
+    {
+        if (row[j] == 0) continue;
+        const double r = hypot(R[j*n + j], row[j]);
+        const double c = R[j*n + j] / r;
+        const double s = row[j] / r;
+        for (int k = j; k < n; k++)
+        {
+            const double Rjk = R[j*n + k];
+            R[j*n + k] = c*Rjk + s*row[k];
+            row[k]     = c*row[k] - s*Rjk;
+        }
+    }
+}
+
+void IncrementalCubicFit::Reset(){
+    fill(R, R + FEATURES*FEATURES, 0.0);
+    scale = 0;
+    length = 0;
+    first_x = first_y = 0;
+    last_x = last_y = 0;
+    count = 0;
+    rebases = 0;
+}
+
+void IncrementalCubicFit::Rebase(const double new_scale){
+    // u' = u * k, so column j (u^j) of the row matrix and of R scale by k^j.
+    // R stays upper triangular, no rows have to be revisited.
+    const double k = scale / new_scale;
+    const double column_scale[FEATURES] = {1, k, k*k, k*k*k, 1, 1};
+    for (int _m = 0; _m < FEATURES; _m++)
+    {
+        for (int _n = _m; _n < FEATURES; _n++)
+        {
+            R[_m*FEATURES + _n] *= column_scale[_n];
+        }
+    }
+    scale = new_scale;
+    rebases++;
+}
+
+void IncrementalCubicFit::AddPoint(const Point p){
+    if (count == 0){
+        first_x = p.x;
+        first_y = p.y;
+    }
+    else {
+        length += (double)(p - Point(last_x, last_y)).len();
+    }
+    last_x = p.x;
+    last_y = p.y;
+    count++;
+
+    // The first non zero length sets the scale, after that it doubles whenever u passes 2.
+    if (scale == 0 && length > 0) scale = length;
+    else if (scale > 0 && length > 2 * scale) Rebase(length);
+
+    const double u = scale > 0 ? length / scale : 0;
+    double row[FEATURES] = {1, u, u*u, u*u*u, p.x, p.y};
+    givens_update(R, row, FEATURES);
+}
+
+const Bezier IncrementalCubicFit::Current() const{
+    assert(count >= 2, "Not enough points to fit cubic bezier!");
+
+    const Point P0(first_x, first_y);
+    const Point P3(last_x, last_y);
+    if (count < 4 || length == 0) return Bezier(P0, P0, P3, P3);
+
+    // t = u * k. Every column of the cubic system is a fixed combination of the feature columns:
+    //  a  = 3(1-t)^2 t           = 3k u - 6k^2 u^2 + 3k^3 u^3
+    //  b  = 3(1-t) t^2           = 3k^2 u^2 - 3k^3 u^3
+    //  rx = x - (1-t)^3 P0x - t^3 P3x
+    const double k = scale / length;
+    const double k2 = k*k, k3 = k2*k;
+    const double columns[4][FEATURES] = {
+        {0, 3*k, -6*k2, 3*k3, 0, 0},
+        {0, 0, 3*k2, -3*k3, 0, 0},
+        {-P0.x, 3*k*P0.x, -3*k2*P0.x, k3*(P0.x - P3.x), 1, 0},
+        {-P0.y, 3*k*P0.y, -3*k2*P0.y, k3*(P0.y - P3.y), 0, 1},
+    };
+
+    // ||F*c|| = ||R*c||, so the m row problem shrinks to the 6 rows of R*[a b rx ry],
+    // which are rotated into a 4x4 triangle the same way the points were.
+    double R4[4 * 4] = {0};
+    for (int _m = 0; _m < FEATURES; _m++)
+    {
+        double row[4] = {0};
+        for (int c = 0; c < 4; c++)
+        {
+            for (int _n = _m; _n < FEATURES; _n++)
+            {
+                row[c] += R[_m*FEATURES + _n] * columns[c][_n];
+            }
+        }
+        givens_update(R4, row, 4);
+    }
+
+    // [R Q^T*bx Q^T*by] are the first two rows of R4.
+    if (fabs(R4[0]) == 0 || fabs(R4[5]) == 0) return Bezier(P0, P0, P3, P3);
+    const double X1 = R4[6] / R4[5];
+    const double Y1 = R4[7] / R4[5];
+    const double X0 = (R4[2] - R4[1] * X1) / R4[0];
+    const double Y0 = (R4[3] - R4[1] * Y1) / R4[0];
+
+    return Bezier(P0, Point((float)X0, (float)Y0), Point((float)X1, (float)Y1), P3);
+}
+
+//------------------------------------------------------------------------------------------------
+
+const Point BezierCubic(float t, const Bezier bezier){
+    assert(t >= 0, "T must be in range of [0, 1]");
+    assert(t <= 1, "T must be in range of [0, 1]");
+    
+    const Point P0 = bezier.P0;
+    const Point P1 = bezier.P1;
+    const Point P2 = bezier.P2;
+    const Point P3 = bezier.P3;
+
+    return  P0 * powf(1-t, 3) +
+    P1 * 3 * powf(1-t, 2) * t +
+    P2 * 3 * (1-t) * t*t +
+    P3 * t*t*t;
+}
+
+// Distance of every point from the closest point of b.
+void closest_distances(const Bezier& b, const PointBuffer& points, float* distance){
+    const float control[8] = {b.P0.x, b.P0.y, b.P1.x, b.P1.y, b.P2.x, b.P2.y, b.P3.x, b.P3.y};
+    Simd().bezier_distance(control, points.X(), points.Y(), distance, points.Size());
+}
+
+double EvaluateBezier(const Bezier bezier, const PointBuffer& points, const ErrorMetric metric){
+    if (points.Size() <= 2) return 0;
+    ArenaScope scratch;
+    if (metric == ErrorMetric::ChordSum) {
+        const vec t(chord_lenght_parameterize(points));
+        assert(t.size() == points.Size(), "The number of Ts and points do not match.");
+        return bezier_error(bezier, points, t.data());
+    }
+
+    vec distance(points.Size());
+    closest_distances(bezier, points, distance.data());
+    double sum = 0, sum_squares = 0, furthest = 0;
+    for (float d : distance)
+    {
+        sum += d;
+        sum_squares += (double)d*d;
+        furthest = fmax(furthest, d);
+    }
+    switch (metric)
+    {
+    case ErrorMetric::RMS: return sqrt(sum_squares / points.Size());
+    case ErrorMetric::Max: return furthest;
+    default:               return sum;
+    }
+}
+
+double EvaluateBezier(const Bezier bezier, const vector<Point>& points, const ErrorMetric metric){
+    return EvaluateBezier(bezier, packed(points), metric);
+}
+
+// Largest distance of a point from the closest point of b, and the index of that point.
+float furthest_point(const Bezier& b, const PointBuffer& points, size_t* index){
+    ArenaScope scratch;
+    vec distance(points.Size());
+    closest_distances(b, points, distance.data());
+
+    *index = max_element(distance.begin(), distance.end()) - distance.begin();
+    return distance[*index];
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Ranges at least this long hand their right half to the task pool, shorter ones are not worth a task.
+static const size_t PIECEWISE_TASK_MIN_POINTS = 1024;
+
+// Split tree of FitPiecewiseBezier. Every node fits points [first, last], neighbouring pieces share their end point.
+struct PiecewiseFit
+{
+    const PointBuffer& points;
+    const float tolerance;
+    const FitOptions& options;
+    TaskPool& pool;
+    TaskGroup group;
+
+    mutex pieces_mutex;
+    vector<pair<size_t, Bezier>> pieces; // First point of the piece, for the final order
+
+    PiecewiseFit(const PointBuffer& points, const float tolerance, const FitOptions& options, TaskPool& pool)
+        : points(points), tolerance(tolerance), options(options), pool(pool) {}
+
+    void Fit(size_t first, size_t last){
+        thread_local PointBuffer shared_piece;
+        while (true)
+        {
+            // A piece fitted with the TSQR waits on the pool, and the thread may run another Fit meanwhile,
+            // so those get a buffer of their own.
+            const size_t count = last - first + 1;
+            PointBuffer own_piece;
+            PointBuffer& piece = count >= options.parallel_min_points ? own_piece : shared_piece;
+            piece.Assign(points.X() + first, points.Y() + first, count);
+            const Bezier bezier = FitCubicBezier(piece, options);
+
+            // 3 points are always matched exactly, so the recursion ends there at the latest.
+            size_t split;
+            if (count <= 3 || furthest_point(bezier, piece, &split) <= tolerance) {
+                lock_guard<mutex> lock(pieces_mutex);
+                pieces.push_back({first, bezier});
+                return;
+            }
+            split = first + min(max(split, (size_t)1), count - 2);
+
+            // Left half here, right half by the pool or the next iteration.
+            if (count >= PIECEWISE_TASK_MIN_POINTS) {
+                pool.Submit(group, [this, split, last](){ Fit(split, last); });
+                last = split;
+            }
+            else {
+                Fit(first, split);
+                first = split;
+            }
+        }
+    }
+};
+
+// Pulls the inner control points of a piece towards those of the straight line between its ends, relative to the
+// mean diagonal. Only there so pieces of 2 or 3 points, which the points do not pin down, have a unique solution.
+static const double CHAIN_SMOOTHING = 1e-6;
+
+// Least squares fit of all pieces between consecutive joints at once, the joints stay on their points.
+// At every smooth joint J between pieces k-1 and k with arc lengths h, (J - P2) / h[k-1] = (P1' - J) / h[k]
+// holds exactly. Per coordinate the unknowns are ordered P1 P2 of piece 0, then for every smooth joint its
+// multiplier followed by P1 P2 of the next piece, which makes the KKT system tridiagonal:
+//
+//   | N0          |                 N = A^T*A of one piece, 2 x 2
+//   |    0  c     |                 c = the multiplier's weights on P2 before and P1 after it
+//   |    c  N1    |
+//
+// x and y share the matrix, so it is factored once with LDL^T and solved twice, O(points + pieces).
+// smooth[k] tells whether joint k, the first point of piece k, is constrained. Empty if the system is singular.
+const vector<Bezier> fit_tangent_continuous(const PointBuffer& points, const size_t* joints, const uint8_t* smooth, const size_t pieces){
+    ArenaScope scratch;
+    const float* x = points.X();
+    const float* y = points.Y();
+
+    // Arc length of every piece, and the index of its P1 in the system.
+    ArenaVector<double> length(pieces, 0.0);
+    ArenaVector<int> unknown(pieces, 0);
+    int size = 0;
+    for (size_t k = 0; k < pieces; k++)
+    {
+        for (size_t i = joints[k] + 1; i <= joints[k+1]; i++) length[k] += hypot((double)x[i] - x[i-1], (double)y[i] - y[i-1]);
+        if (k > 0 && smooth[k]) size++;
+        unknown[k] = size;
+        size += 2;
+    }
+
+    BandedMatrix KKT(size, 1);
+    ArenaVector<double> bx(size, 0.0), by(size, 0.0);
+    for (size_t k = 0; k < pieces; k++)
+    {
+        const size_t first = joints[k], last = joints[k+1];
+        const double x0 = x[first], y0 = y[first], x3 = x[last], y3 = y[last];
+        double s00 = 0, s01 = 0, s11 = 0, rx0 = 0, rx1 = 0, ry0 = 0, ry1 = 0;
+        double arc = 0;
+        for (size_t i = first + 1; i < last; i++)
+        {
+            arc += hypot((double)x[i] - x[i-1], (double)y[i] - y[i-1]);
+            const double t = length[k] > 0 ? arc / length[k] : 0.5, s = 1 - t;
+            const double a = 3*s*s*t, b = 3*s*t*t;
+            const double rx = x[i] - x0*s*s*s - x3*t*t*t, ry = y[i] - y0*s*s*s - y3*t*t*t;
+            s00 += a*a; s01 += a*b; s11 += b*b;
+            rx0 += a*rx; rx1 += b*rx; ry0 += a*ry; ry1 += b*ry;
+        }
+        const double lambda = CHAIN_SMOOTHING * fmax((s00 + s11) / 2, 1.0);
+        const int u = unknown[k];
+        KKT(u, u) = s00 + lambda;
+        KKT(u+1, u) = s01;
+        KKT(u+1, u+1) = s11 + lambda;
+        bx[u] = rx0 + lambda * (2*x0 + x3) / 3;
+        by[u] = ry0 + lambda * (2*y0 + y3) / 3;
+        bx[u+1] = rx1 + lambda * (x0 + 2*x3) / 3;
+        by[u+1] = ry1 + lambda * (y0 + 2*y3) / 3;
+
+        if (k > 0 && smooth[k]) {
+            // w_before * P2 + w_after * P1' = J, the weights sum to 1 so J lies between them.
+            const double total = length[k-1] + length[k];
+            const double w_before = total > 0 ? length[k] / total : 0.5;
+            const int m = u - 1;
+            KKT(m, m - 1) = w_before;
+            KKT(u, m) = 1 - w_before;
+            bx[m] = x0;
+            by[m] = y0;
+        }
+    }
+
+    vector<Bezier> chain;
+    chain.reserve(pieces);
+    if (!KKT.LDLT()) return chain;
+    KKT.SolveLDLTInPlace(bx.data());
+    KKT.SolveLDLTInPlace(by.data());
+    for (size_t k = 0; k < pieces; k++)
+    {
+        const int u = unknown[k];
+        chain.push_back(Bezier(points[joints[k]], Point((float)bx[u], (float)by[u]), Point((float)bx[u+1], (float)by[u+1]), points[joints[k+1]]));
+    }
+    return chain;
+}
+
+// Rounds of splitting pieces the joint solve pushed beyond tolerance before giving up on their continuity.
+static const int CHAIN_MAX_REFINEMENTS = 8;
+
+// fit_tangent_continuous that keeps every point within tolerance of its piece. A piece the joint solve moved
+// beyond tolerance is split at its furthest point with a smooth joint, and the whole chain solved again.
+// Pieces still beyond after CHAIN_MAX_REFINEMENTS rounds are replaced by the unconstrained split tree of their
+// range, tolerance wins over continuity at their ends. Empty if the system is singular.
+const vector<Bezier> fit_tangent_continuous_within(const PointBuffer& points, vector<size_t> joints, vector<uint8_t> smooth,
+    const float tolerance, const FitOptions& options, TaskPool& pool){
+    PointBuffer piece;
+    for (int refinement = 0; ; refinement++)
+    {
+        const vector<Bezier> chain = fit_tangent_continuous(points, joints.data(), smooth.data(), smooth.size());
+        if (chain.empty()) return chain;
+
+        vector<Bezier> result;
+        vector<size_t> split_joints;
+        vector<uint8_t> split_smooth;
+        bool within = true;
+        for (size_t k = 0; k < chain.size(); k++)
+        {
+            const size_t first = joints[k], last = joints[k+1], count = last - first + 1;
+            split_joints.push_back(first);
+            split_smooth.push_back(smooth[k]);
+
+            // 2 point pieces have nothing to be off, so a piece beyond tolerance always has a point to split at.
+            piece.Assign(points.X() + first, points.Y() + first, count);
+            size_t split;
+            if (furthest_point(chain[k], piece, &split) <= tolerance) {
+                result.push_back(chain[k]);
+                continue;
+            }
+            within = false;
+            if (refinement < CHAIN_MAX_REFINEMENTS) {
+                split_joints.push_back(first + min(max(split, (size_t)1), count - 2));
+                split_smooth.push_back(1);
+                continue;
+            }
+            PiecewiseFit fallback(points, tolerance, options, pool);
+            fallback.Fit(first, last);
+            pool.Wait(fallback.group);
+            sort(fallback.pieces.begin(), fallback.pieces.end(), [](const pair<size_t, Bezier>& a, const pair<size_t, Bezier>& b){ return a.first < b.first; });
+            for (const pair<size_t, Bezier>& fallback_piece : fallback.pieces) result.push_back(fallback_piece.second);
+        }
+        if (within || refinement == CHAIN_MAX_REFINEMENTS) return result;
+
+        split_joints.push_back(points.Size() - 1);
+        joints.swap(split_joints);
+        smooth.swap(split_smooth);
+    }
+}
+
+// Every stretch between two consecutive corners is a root of the split tree, all but the last go to the pool.
+const vector<Bezier> fit_piecewise(const PointBuffer& points, const size_t* corners, const size_t corner_count, const float tolerance, const FitOptions& options, TaskPool& pool){
+    assert(points.Size() >= 2, "Not enough points to fit cubic bezier!");
+    assert(tolerance > 0, "Tolerance must be positive!");
+    assert(corner_count >= 2 && corners[0] == 0 && corners[corner_count-1] == points.Size() - 1, "Corners must include the first and last point!");
+
+    PiecewiseFit fit(points, tolerance, options, pool);
+    for (size_t k = 0; k + 2 < corner_count; k++)
+    {
+        assert(corners[k] < corners[k+1], "Corners must be increasing!");
+        const size_t first = corners[k], last = corners[k+1];
+        pool.Submit(fit.group, [&fit, first, last](){ fit.Fit(first, last); });
+    }
+    fit.Fit(corners[corner_count-2], corners[corner_count-1]);
+    fit.pool.Wait(fit.group);
+
+    sort(fit.pieces.begin(), fit.pieces.end(), [](const pair<size_t, Bezier>& a, const pair<size_t, Bezier>& b){ return a.first < b.first; });
+    if (options.tangent_continuous && fit.pieces.size() > 1) {
+        // Joints where the split tree cut, corners stay as they are.
+        const size_t count = fit.pieces.size();
+        vector<size_t> joints(count + 1);
+        vector<uint8_t> smooth(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            joints[k] = fit.pieces[k].first;
+            smooth[k] = k > 0 && !binary_search(corners, corners + corner_count, joints[k]);
+        }
+        joints[count] = points.Size() - 1;
+        vector<Bezier> chain = fit_tangent_continuous_within(points, move(joints), move(smooth), tolerance, options, pool);
+        if (!chain.empty()) return chain;
+    }
+
+    vector<Bezier> result;
+    result.reserve(fit.pieces.size());
+    for (const pair<size_t, Bezier>& piece : fit.pieces) result.push_back(piece.second);
+    return result;
+}
+
+const vector<Bezier> FitPiecewiseBezier(const PointBuffer& points, const float tolerance, const FitOptions& options){
+    const size_t ends[2] = {0, points.Size() - 1};
+    return fit_piecewise(points, ends, 2, tolerance, options, TaskPool::Shared());
+}
+
+const vector<Bezier> FitPiecewiseBezier(const vector<Point>& points, const float tolerance, const FitOptions& options){
+    return FitPiecewiseBezier(packed(points), tolerance, options);
+}
+
+const vector<Bezier> FitSegmentedBezier(const PointBuffer& points, const vector<size_t>& corners, const float tolerance, const FitOptions& options){
+    return fit_piecewise(points, corners.data(), corners.size(), tolerance, options, TaskPool::Shared());
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Angle between the chords from window points back to i and from i to window points ahead, 0 when straight on.
+// Chords over a few points rather than single segments, so jitter does not read as turning.
+float turning_angle(const PointBuffer& points, const size_t i, const int window){
+    const size_t back = i >= (size_t)window ? i - window : 0;
+    const size_t ahead = min(i + window, points.Size() - 1);
+    const float* x = points.X();
+    const float* y = points.Y();
+    const float ax = x[i] - x[back], ay = y[i] - y[back];
+    const float bx = x[ahead] - x[i], by = y[ahead] - y[i];
+    return fabsf(atan2f(ax*by - ay*bx, ax*bx + ay*by));
+}
+
+vector<size_t> FindCorners(const PointBuffer& points, const double* timestamps, const CornerOptions& options){
+    const size_t n = points.Size();
+    vector<size_t> corners = {0};
+    if (n < 3) {
+        if (n == 2) corners.push_back(1);
+        return corners;
+    }
+
+    ArenaScope scratch;
+    vec angle(n, 0.0f), speed(n, 0.0f);
+    for (size_t i = 1; i + 1 < n; i++) angle[i] = turning_angle(points, i, options.window);
+
+    // Speed over the neighbouring segments, the median is the stroke's own idea of fast and slow.
+    float slow = 0;
+    if (timestamps != nullptr) {
+        const float* x = points.X();
+        const float* y = points.Y();
+        for (size_t i = 1; i + 1 < n; i++)
+        {
+            const double elapsed = timestamps[i+1] - timestamps[i-1];
+            const float length = hypotf(x[i+1] - x[i-1], y[i+1] - y[i-1]);
+            speed[i] = elapsed > 0 ? (float)(length / elapsed) : INFINITY;
+        }
+        vec sorted(speed.begin() + 1, speed.end() - 1);
+        nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        slow = sorted[sorted.size() / 2] * options.slow_speed_ratio;
+    }
+
+    // Corners closer than min_spacing to each other or to the ends are merged, the sharpest stays.
+    for (size_t i = options.min_spacing; i + options.min_spacing < n; i++)
+    {
+        const bool sharp = angle[i] >= options.min_turning_angle;
+        const bool stopped = speed[i] < slow && speed[i] <= speed[i-1] && speed[i] <= speed[i+1] && angle[i] >= options.slow_turning_angle;
+        if (!sharp && !stopped) continue;
+
+        if (corners.size() > 1 && i - corners.back() < options.min_spacing) {
+            if (angle[i] > angle[corners.back()]) corners.back() = i;
+        }
+        else corners.push_back(i);
+    }
+    corners.push_back(n - 1);
+    return corners;
+}
+
+//------------------------------------------------------------------------------------------------
+
+// Squared distance of (px, py) from the segment a-b, from a when the segment has no length.
+inline float segment_distance_squared(float px, float py, float ax, float ay, float bx, float by){
+    const float dx = bx - ax, dy = by - ay;
+    const float length_squared = dx*dx + dy*dy;
+    float u = length_squared > 0 ? ((px - ax)*dx + (py - ay)*dy) / length_squared : 0;
+    u = fminf(fmaxf(u, 0.0f), 1.0f);
+    const float ex = ax + u*dx - px, ey = ay + u*dy - py;
+    return ex*ex + ey*ey;
+}
+
+size_t Decimate(PointBuffer& points, const DecimateOptions& options, double* timestamps){
+    const size_t n = points.Size();
+    if (n <= 2) return 0;
+    float* x = points.X();
+    float* y = points.Y();
+
+    // Radial distance, every point is compared to the last one kept.
+    size_t kept = n;
+    if (options.radial_tolerance > 0) {
+        const float radial_squared = options.radial_tolerance * options.radial_tolerance;
+        kept = 1;
+        for (size_t i = 1; i + 1 < n; i++)
+        {
+            const float dx = x[i] - x[kept-1], dy = y[i] - y[kept-1];
+            if (dx*dx + dy*dy < radial_squared) continue;
+            x[kept] = x[i];
+            y[kept] = y[i];
+            if (timestamps != nullptr) timestamps[kept] = timestamps[i];
+            kept++;
+        }
+        x[kept] = x[n-1];
+        y[kept] = y[n-1];
+        if (timestamps != nullptr) timestamps[kept] = timestamps[n-1];
+        kept++;
+    }
+
+    // Ramer-Douglas-Peucker, the furthest point of a range off its end to end segment is kept and
+    // splits the range in two, until every point is within tolerance. Ranges longer than max_spacing
+    // split in the middle when no point is off.
+    if (options.rdp_tolerance > 0 && kept > 2) {
+        ArenaScope scratch;
+        const float rdp_squared = options.rdp_tolerance * options.rdp_tolerance;
+        const float spacing_squared = options.max_spacing > 0 ? options.max_spacing * options.max_spacing : INFINITY;
+        ArenaVector<uint8_t> keep(kept, 0);
+        keep[0] = keep[kept-1] = 1;
+        ArenaVector<pair<size_t, size_t>> ranges;
+        ranges.reserve(64);
+        ranges.push_back({0, kept - 1});
+        while (!ranges.empty())
+        {
+            const size_t first = ranges.back().first, last = ranges.back().second;
+            ranges.pop_back();
+            float furthest = rdp_squared;
+            size_t split = 0;
+            for (size_t i = first + 1; i < last; i++)
+            {
+                const float d = segment_distance_squared(x[i], y[i], x[first], y[first], x[last], y[last]);
+                if (d > furthest) {
+                    furthest = d;
+                    split = i;
+                }
+            }
+            if (split == 0) {
+                const float dx = x[last] - x[first], dy = y[last] - y[first];
+                if (dx*dx + dy*dy <= spacing_squared) continue;
+                split = first + (last - first) / 2;
+            }
+            keep[split] = 1;
+            if (split - first > 1) ranges.push_back({first, split});
+            if (last - split > 1) ranges.push_back({split, last});
+        }
+
+        size_t compacted = 0;
+        for (size_t i = 0; i < kept; i++)
+        {
+            if (!keep[i]) continue;
+            x[compacted] = x[i];
+            y[compacted] = y[i];
+            if (timestamps != nullptr) timestamps[compacted] = timestamps[i];
+            compacted++;
+        }
+        kept = compacted;
+    }
+
+    points.Truncate(kept);
+    return n - kept;
+}
+
+//------------------------------------------------------------------------------------------------
+
+
+
+#ifdef DEBUG_CF
+
+// Every supported instruction set must agree with the scalar kernels within tolerance.
+bool check_simd_kernels(){
+    const size_t sizes[] = {1, 3, 8, 15, 16, 17, 33, 255, 1000};
+    const SimdKernels& reference = SimdKernelsFor(SimdIsa::Scalar);
+    const SimdIsa isas[] = {SimdIsa::SSE2, SimdIsa::AVX2, SimdIsa::AVX512};
+    bool all_passed = true;
+
+    for (SimdIsa isa : isas)
+    {
+        if (!SimdIsaSupported(isa)) {
+            printf("SIMD %s: not supported, skipped\n", SimdIsaName(isa));
+            continue;
+        }
+        const SimdKernels& kernels = SimdKernelsFor(isa);
+
+        float max_error = 0;
+        for (size_t n : sizes)
+        {
+            vec a(n), b(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                a[i] = sinf(i * 0.37f) * 3;
+                b[i] = cosf(i * 0.11f) - 0.5f;
+            }
+            const float tolerance_scale = 1.0f / (n + 1);
+
+            max_error = fmax(max_error, fabs(kernels.dot(a.data(), b.data(), n) - reference.dot(a.data(), b.data(), n)) * tolerance_scale);
+
+            vec y0(b), y1(b);
+            kernels.axpy(0.7f, a.data(), y0.data(), n);
+            reference.axpy(0.7f, a.data(), y1.data(), n);
+            for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(y0[i] - y1[i]));
+
+            kernels.add(a.data(), b.data(), y0.data(), n);
+            reference.add(a.data(), b.data(), y1.data(), n);
+            for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(y0[i] - y1[i]));
+
+            kernels.sub(a.data(), b.data(), y0.data(), n);
+            reference.sub(a.data(), b.data(), y1.data(), n);
+            for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(y0[i] - y1[i]));
+
+            kernels.scale(a.data(), -1.3f, y0.data(), n);
+            reference.scale(a.data(), -1.3f, y1.data(), n);
+            for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(y0[i] - y1[i]));
+
+            // Two columns, the unit reflector is a normalized.
+            const float inv_len = 1 / sqrtf(reference.dot(a.data(), a.data(), n));
+            vec w(n);
+            reference.scale(a.data(), inv_len, w.data(), n);
+            vec A0(2*n), A1(2*n);
+            for (size_t i = 0; i < n; i++) { A0[i] = A1[i] = b[i]; A0[n+i] = A1[n+i] = a[i] * 0.5f; }
+            kernels.reflector_update(w.data(), A0.data(), n, 2, n);
+            reference.reflector_update(w.data(), A1.data(), n, 2, n);
+            for (size_t i = 0; i < 2*n; i++) max_error = fmax(max_error, fabs(A0[i] - A1[i]));
+
+            // 3 x n row major
+            vec M(3*n), r0(3), r1(3);
+            for (size_t i = 0; i < 3*n; i++) M[i] = sinf(i * 0.05f);
+            kernels.matvec(M.data(), a.data(), r0.data(), 3, n);
+            reference.matvec(M.data(), a.data(), r1.data(), 3, n);
+            for (size_t i = 0; i < 3; i++) max_error = fmax(max_error, fabs(r0[i] - r1[i]) * tolerance_scale);
+
+            // k = n deep GEMM tile
+            vec a_panel(GEMM_MR*n), b_panel(GEMM_NR*n), t0(GEMM_MR*GEMM_NR), t1(GEMM_MR*GEMM_NR);
+            for (size_t i = 0; i < GEMM_MR*n; i++) a_panel[i] = sinf(i * 0.13f);
+            for (size_t i = 0; i < GEMM_NR*n; i++) b_panel[i] = cosf(i * 0.07f);
+            kernels.gemm_micro(n, a_panel.data(), b_panel.data(), t0.data());
+            reference.gemm_micro(n, a_panel.data(), b_panel.data(), t1.data());
+            for (int i = 0; i < GEMM_MR*GEMM_NR; i++) max_error = fmax(max_error, fabs(t0[i] - t1[i]) * tolerance_scale);
+
+            // n points deep batch, lane l masked to n - l points
+            const int L = FIT_BATCH_LANES;
+            vec bx(n*L), by(n*L), s0(FIT_BATCH_SUMS*L), s1(FIT_BATCH_SUMS*L);
+            int lane_count[FIT_BATCH_LANES];
+            for (int l = 0; l < L; l++) lane_count[l] = max(0, (int)n - l);
+            for (size_t i = 0; i < n*L; i++) { bx[i] = (i / L) * 0.5f + sinf(i * 0.3f); by[i] = cosf(i * 0.2f); }
+            kernels.fit_batch(bx.data(), by.data(), lane_count, n, s0.data());
+            reference.fit_batch(bx.data(), by.data(), lane_count, n, s1.data());
+            for (int i = 0; i < FIT_BATCH_SUMS*L; i++)
+            {
+                if (isnan(s0[i]) != isnan(s1[i])) max_error = INFINITY;
+                else if (!isnan(s0[i])) max_error = fmax(max_error, fabs(s0[i] - s1[i]) / (fabs(s1[i]) + 1));
+            }
+
+            // n + 1 points of a polyline, both running sum widths
+            if (n >= 2) {
+                vec c0(n), c1(n);
+                kernels.chord_parameterize(a.data(), b.data(), n, c0.data());
+                reference.chord_parameterize(a.data(), b.data(), n, c1.data());
+                for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(c0[i] - c1[i]));
+                kernels.chord_parameterize_wide(a.data(), b.data(), n, c0.data());
+                reference.chord_parameterize_wide(a.data(), b.data(), n, c1.data());
+                for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(c0[i] - c1[i]));
+            }
+
+            // One Newton step of every t towards the points, from t off by a little
+            const float control[8] = {-4, -1.7f, -1.5f, 2.5f, 1.5f, -2, 3, 2};
+            vec n0(n), n1(n);
+            for (size_t i = 0; i < n; i++) n0[i] = n1[i] = fmin(1.0f, fmax(0.0f, i / (float)n + 0.05f * sinf(i * 0.7f)));
+            kernels.bezier_newton(control, a.data(), b.data(), n0.data(), n);
+            reference.bezier_newton(control, a.data(), b.data(), n1.data(), n);
+            for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(n0[i] - n1[i]));
+
+            // Closest point distances, relative to the size of the curve
+            kernels.bezier_distance(control, a.data(), b.data(), n0.data(), n);
+            reference.bezier_distance(control, a.data(), b.data(), n1.data(), n);
+            for (size_t i = 0; i < n; i++) max_error = fmax(max_error, fabs(n0[i] - n1[i]) / 10);
+        }
+
+        const bool passed = max_error < 1e-4f;
+        all_passed &= passed;
+        printf("SIMD %s: max deviation from scalar %g, %s\n", SimdIsaName(isa), max_error, passed ? "OK" : "FAILED");
+    }
+    printf("SIMD dispatch picked %s\n\n", SimdIsaName(Simd().isa));
+    return all_passed;
+}
+
+// GFLOP/s of A^T * A, the Gram matrix of the fit, for tall thin A in both layouts.
+// The blocked path must agree with the row path.
+bool benchmark_matmul(){
+    const int rows[] = {4, 64, 1000, 10000, 100000};
+    const int cols[] = {2, 8};
+    bool all_passed = true;
+
+    printf("%8s %3s %-8s %12s %12s\n", "m", "n", "layout", "rows GF/s", "blocked GF/s");
+    for (int n : cols)
+    {
+        for (int m : rows)
+        {
+            vec data((size_t)m*n);
+            for (size_t i = 0; i < data.size(); i++) data[i] = sinf(i * 0.013f);
+
+            for (Layout layout : {Layout::RowMajor, Layout::ColumnMajor})
+            {
+                const Matrix A(m, n, data, layout);
+                const MatrixView At = A.View().Transposed(), Av = A.View();
+                vec C0((size_t)n*n), C1((size_t)n*n);
+
+                // Enough repetitions for roughly 50M multiply-adds.
+                const int repetitions = max(1, 50000000 / (m*n*n));
+                const double flops = 2.0 * m * n * n * repetitions;
+
+                auto start = chrono::steady_clock::now();
+                for (int r = 0; r < repetitions; r++) multiply_rows(At, Av, C0.data());
+                const double rows_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+                start = chrono::steady_clock::now();
+                for (int r = 0; r < repetitions; r++) multiply_blocked(At, Av, C1.data());
+                const double blocked_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+                float max_error = 0;
+                for (size_t i = 0; i < C0.size(); i++) max_error = fmax(max_error, fabs(C0[i] - C1[i]) / (fabs(C0[i]) + 1));
+                const bool passed = max_error < 1e-3f;
+                all_passed &= passed;
 
-        vec result; result.reserve(count);
-        for (int i = 0; i < count; i++)
-        {
-            result.push_back(contents[start+i]);
+                printf("%8d %3d %-8s %12.2f %12.2f%s\n", m, n, layout == Layout::RowMajor ? "row" : "column",
+                    flops / rows_seconds * 1e-9, flops / blocked_seconds * 1e-9, passed ? "" : "  MISMATCH");
+            }
         }
-        
-        return result;
-    }
-
-    const Vector Reverse() const{
-        vec result; result.reserve(contents.size());
-        copy(contents.crbegin(), contents.crend(), back_inserter(result));
-        return result;
     }
+    printf("\n");
+    return all_passed;
+}
 
-    const Vector operator+(const Vector rhs) const{
-        assert(Size() == rhs.Size(), "Mismatched vectors are not allowed.");
-        vec result(Size(), 0);
-        for (size_t i = 0; i < Size(); i++)
+// Points per second of the chord length kernel on every ISA, and how far the float and double running sums
+// drift from a double reference on a very long stroke.
+bool benchmark_chord_parameterize(){
+    const size_t n = 1 << 20;
+    PointBuffer points;
+    points.Reserve(n);
+    for (size_t i = 0; i < n; i++) points.PushBack(Point(i * 0.01f + sinf(i * 0.003f), cosf(i * 0.002f) * 20));
+
+    // Own arena, the thread's one should not grow to the size of this stroke.
+    FitArena arena;
+    ArenaScope scratch(arena);
+    const ArenaVector<double> reference = chord_lenght_parameterize<double>(points);
+    vec t(n);
+    bool all_passed = true;
+
+    const SimdIsa isas[] = {SimdIsa::Scalar, SimdIsa::SSE2, SimdIsa::AVX2, SimdIsa::AVX512};
+    for (SimdIsa isa : isas)
+    {
+        if (!SimdIsaSupported(isa)) continue;
+        const SimdKernels& kernels = SimdKernelsFor(isa);
+        const int repetitions = 20;
+        double drift[2];
+        double seconds[2];
+        for (int wide = 0; wide < 2; wide++)
         {
-            result[i] = Get(i) + rhs.Get(i);
+            const auto parameterize = wide ? kernels.chord_parameterize_wide : kernels.chord_parameterize;
+            const auto start = chrono::steady_clock::now();
+            for (int r = 0; r < repetitions; r++) parameterize(points.X(), points.Y(), n, t.data());
+            seconds[wide] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            drift[wide] = 0;
+            for (size_t i = 0; i < n; i++) drift[wide] = fmax(drift[wide], fabs(t[i] - reference[i]));
         }
-        return result;
+        // Float resolution of t itself is ~6e-8, the wide sum must stay near it.
+        const bool passed = drift[1] < 1e-6;
+        all_passed &= passed;
+        printf("Chord %-7s: %7.0f Mpoints/s float sum (drift %.2e), %7.0f Mpoints/s double sum (drift %.2e)%s\n", SimdIsaName(isa),
+            n * repetitions / seconds[0] * 1e-6, drift[0], n * repetitions / seconds[1] * 1e-6, drift[1], passed ? "" : "  MISMATCH");
     }
+    printf("\n");
+    return all_passed;
+}
 
-    const Vector operator-(const Vector rhs) const{
-        assert(Size() == rhs.Size(), "Mismatched vectors are not allowed.");
-        vec result(Size(), 0);
-        for (size_t i = 0; i < Size(); i++)
-        {
-            result[i] = Get(i) - rhs.Get(i);
-        }
-        return result;
+// Control point deviation of each precision from the double fit, on a stroke far from the origin
+// where float rounding of the right hand side dominates.
+bool check_precision_modes(){
+    vector<Point> points;
+    for (int i = 0; i < 255; i++)
+    {
+        const float s = i / 254.0f;
+        points.push_back(Point(30000 + 400 * s + 50 * sinf(s * 5), 20000 + 300 * s*s + 40 * cosf(s * 3)));
     }
 
-    const Vector operator*(const float rhs) const{
-        vec result(Size(), 0);
-        for (size_t i = 0; i < Size(); i++)
-        {
-            result[i] = Get(i) * rhs;
-        }
-        return result;
+    const Bezier reference = FitCubicBezier(points, {FitSolver::Householder, FitPrecision::Double});
+    const FitPrecision precisions[] = {FitPrecision::Float, FitPrecision::Double, FitPrecision::Mixed};
+    const char* names[] = {"float", "double", "mixed"};
+    float mixed_deviation = 0, float_deviation = 0;
+
+    for (int p = 0; p < 3; p++)
+    {
+        const FitOptions options = {FitSolver::Householder, precisions[p]};
+        const int fits = 2000;
+        const auto start = chrono::steady_clock::now();
+        for (int i = 0; i < fits; i++) FitCubicBezier(points, options);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        const Bezier b = FitCubicBezier(points, options);
+        const float deviation = fmax((b.P1 - reference.P1).len(), (b.P2 - reference.P2).len());
+        if (precisions[p] == FitPrecision::Mixed) mixed_deviation = deviation;
+        if (precisions[p] == FitPrecision::Float) float_deviation = deviation;
+        printf("Precision %-6s: %.2f us per fit, control points %g from double\n", names[p], seconds / fits * 1e6, deviation);
     }
+    printf("\n");
+    return mixed_deviation <= float_deviation;
+}
 
-    const Vector operator/(const float rhs) const{
-        vec result(Size(), 0);
-        float x = 1 / rhs; // Lessen the number of divisions
-        for (size_t i = 0; i < Size(); i++)
+// Error of the resampled fit against the exact chord length fit for every cached count, measured on the original points.
+// Strokes are sampled unevenly, as a pen slowing into curves would.
+bool report_resampled_accuracy(){
+    vector<PointBuffer> strokes;
+    for (int i = 0; i < 200; i++)
+    {
+        PointBuffer stroke;
+        const int length = 20 + (i * 53) % 480;
+        for (int j = 0; j < length; j++)
         {
-            result[i] = Get(i) * x;
+            const float u = j / (float)(length - 1);
+            const float s = u + 0.15f * sinf(u * 9 + i); // Uneven speed
+            stroke.PushBack(Point(200 * s + 30 * sinf(s * 3 + i * 0.1f), 120 * s*s - 40 * cosf(s * 4 - i * 0.2f)));
         }
-        return result;
+        strokes.push_back(stroke);
     }
 
-    const float Magnitude() const{
-        float square_sum = 0;
-        for (size_t i = 0; i < Size(); i++)
+    const auto run = [&](const FitOptions& options, double* mean_error, double* seconds){
+        const int repetitions = 20;
+        const auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
         {
-            square_sum += Get(i)*Get(i);
+            for (const PointBuffer& stroke : strokes) FitCubicBezier(stroke, options);
         }
-        return sqrtf(square_sum);
-    }
-
-    const Vector Normalize() const {
-        if (Magnitude() == 0) return *this;
-        return *this / Magnitude();
-    }
+        *seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / (repetitions * strokes.size());
 
-    explicit operator const vec() const { return contents; }
+        *mean_error = 0;
+        for (const PointBuffer& stroke : strokes) *mean_error += EvaluateBezier(FitCubicBezier(stroke, options), stroke) / stroke.Size();
+        *mean_error /= strokes.size();
+    };
 
-    private:
-    const vec contents;
-};
+    double exact_error, exact_seconds;
+    run(FitOptions(), &exact_error, &exact_seconds);
+    printf("Resample %-5s: %6.2f us per fit, mean distance per point %.4f\n", "exact", exact_seconds * 1e6, exact_error);
 
-const Vector operator*(float lhs, const Vector rhs){
-    return rhs * lhs;
+    double last_ratio = 0;
+    for (int count : RESAMPLED_FIT_TABLE_COUNTS)
+    {
+        FitOptions options;
+        options.resample_count = count;
+        double error, seconds;
+        run(options, &error, &seconds);
+        last_ratio = error / exact_error;
+        printf("Resample %-5d: %6.2f us per fit, mean distance per point %.4f, %.3fx exact\n", count, seconds * 1e6, error, last_ratio);
+    }
+    printf("\n");
+    return last_ratio < 1.1;
 }
 
-struct Matrix
-{
-    private:
-    const vec contents;
-
-    public:
-    const int m, n;
-
-    Matrix(int m, int n, const vec from_vec) : contents(from_vec), m(m), n(n){
-        assert((int)from_vec.size() == m*n, "Input vector must fill give m*n matrix!");
+// Closest point distances against a dense sampling of the curve, and their throughput per instruction set
+// on a 10k point stroke, which has to be measured every frame well within its 16 ms.
+bool benchmark_closest_point(){
+    // A loop, a cusp and a plain arc, with points all around them
+    const float curves[3][8] = {{0, 0, 300, 200, -100, 200, 200, 0}, {0, 0, 200, 100, 0, 100, 200, 0}, {0, 0, 50, 100, 150, 100, 200, 0}};
+    const size_t n = 10000;
+    vec x(n), y(n), distance(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = -100 + 400 * fmodf(i * 0.6180339f, 1.0f);
+        y[i] = -100 + 300 * fmodf(i * 0.7548776f, 1.0f);
     }
 
-    Matrix(Vector from_vec, bool transposed = false) : 
-        contents(from_vec), 
-        m(!transposed ? from_vec.Size() : 1),
-        n( transposed ? from_vec.Size() : 1)
-    {}
-
-    void DebugDisplay(const char* name) const{
-        printf("Matrix %s:\n", name);
-        for (int _m = 0; _m < m; _m++)
+    // The sampled minimum is at most a tiny bit above the exact one and never below.
+    const int samples = 20000;
+    float max_deviation = 0;
+    for (const float* control : curves)
+    {
+        const Bezier b(Point(control[0], control[1]), Point(control[2], control[3]), Point(control[4], control[5]), Point(control[6], control[7]));
+        Simd().bezier_distance(control, x.data(), y.data(), distance.data(), n);
+        for (size_t i = 0; i < n; i += 10)
         {
-            printf("\t");
-            for (int _n = 0; _n < n; _n++)
+            float sampled = INFINITY;
+            for (int k = 0; k <= samples; k++)
             {
-                printf("| %f ", Get(_m, _n));
+                const Point p = BezierCubic(k / (float)samples, b);
+                sampled = fmin(sampled, hypotf(p.x - x[i], p.y - y[i]));
             }
-            printf("|\n");
+            max_deviation = fmax(max_deviation, fabs(sampled - distance[i]));
         }
-        printf("\\Matrix\n\n");
     }
+    const bool passed = max_deviation < 1e-2f;
+    printf("Closest point: max deviation from %d samples %g, %s\n", samples, max_deviation, passed ? "OK" : "FAILED");
 
-    static const Matrix Identity(const int size){
-        assert(size > 0, "Matrix size must be bigger than 0");
-        vec result(size*size, 0);
-        for (int i = 0; i < size; i++)
+    for (SimdIsa isa : {SimdIsa::Scalar, SimdIsa::SSE2, SimdIsa::AVX2, SimdIsa::AVX512})
+    {
+        if (!SimdIsaSupported(isa)) continue;
+        const SimdKernels& kernels = SimdKernelsFor(isa);
+        const int repetitions = 50;
+        const auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
         {
-            // nth row, nth column
-            result[size * i + i] = 1;
+            for (const float* control : curves) kernels.bezier_distance(control, x.data(), y.data(), distance.data(), n);
         }
-        return Matrix(size, size, result);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / (repetitions * 3);
+        printf("Closest point %-7s: %7.1f Mpoints/s, %6.0f us per %zu point stroke\n", SimdIsaName(isa), n / seconds * 1e-6, seconds * 1e6, n);
     }
 
-    const Matrix Transpose() const{
-        vec transposed_contents; transposed_contents.reserve(m*n);
-        for (int _n = 0; _n < n; _n++)
+    PointBuffer stroke;
+    stroke.Assign(x.data(), y.data(), n);
+    const Bezier b(Point(0, 0), Point(50, 100), Point(150, 100), Point(200, 0));
+    printf("Metrics: chord sum %.1f, sum %.1f, rms %.2f, max %.2f\n\n", EvaluateBezier(b, stroke), EvaluateBezier(b, stroke, ErrorMetric::Sum),
+        EvaluateBezier(b, stroke, ErrorMetric::RMS), EvaluateBezier(b, stroke, ErrorMetric::Max));
+    return passed && EvaluateBezier(b, stroke, ErrorMetric::Sum) <= EvaluateBezier(b, stroke);
+}
+
+// Error and time of every Newton reparameterization iteration on unevenly sampled noisy strokes.
+// The error must never grow from one iteration to the next.
+bool report_reparameterization(){
+    const int iterations = 6;
+    vector<double> error(iterations + 1, 0.0), microseconds(iterations + 1, 0.0);
+    vector<int> reached(iterations + 1, 0);
+    bool monotonic = true;
+
+    const int strokes = 100;
+    for (int i = 0; i < strokes; i++)
+    {
+        PointBuffer stroke;
+        const int length = 20 + (i * 37) % 300;
+        for (int j = 0; j < length; j++)
         {
-            for (int _m = 0; _m < m; _m++)
-            {
-                // target = _m*n + _n
-                transposed_contents.push_back(contents[_m*n + _n]);
-            }
+            const float u = j / (float)(length - 1);
+            const float s = u + 0.15f * sinf(u * 9 + i); // Uneven speed
+            stroke.PushBack(Point(200 * s + 30 * sinf(s * 3 + i * 0.1f) + 0.5f * sinf(j * 2.3f), 120 * s*s - 40 * cosf(s * 4 - i * 0.2f)));
+        }
+
+        FitReport report;
+        FitOptions options;
+        options.reparameterize_iterations = iterations;
+        options.reparameterize_min_improvement = 0;
+        options.report = &report;
+        FitCubicBezier(stroke, options);
+
+        error[0] += report.chord_error / stroke.Size();
+        reached[0]++;
+        double previous = report.chord_error;
+        for (size_t k = 0; k < report.iterations.size(); k++)
+        {
+            // The last entry may be the rejected iteration that stopped the loop.
+            if (k + 1 == report.iterations.size() && !(report.iterations[k].error < previous)) break;
+            monotonic &= report.iterations[k].error <= previous;
+            previous = report.iterations[k].error;
+            error[k+1] += report.iterations[k].error / stroke.Size();
+            microseconds[k+1] += report.iterations[k].microseconds;
+            reached[k+1]++;
         }
-        return Matrix(n,m,transposed_contents);
     }
 
-    static float GetIdx(int y, int x, int n) {
-        assert(y >= 0, "Row must not be negative!");
-        assert(x >= 0, "column must not be negative!");
-        assert(n >  0, "Height must be bigger than 0!");
-        return y * n + x;
+    for (int k = 0; k <= iterations && reached[k] > 0; k++)
+    {
+        printf("Reparameterize %d: mean distance per point %.4f, %6.2f us per iteration, %d of %d strokes\n",
+            k, error[k] / reached[k], microseconds[k] / reached[k], reached[k], strokes);
     }
+    printf("%s\n\n", monotonic ? "Error never grows, OK" : "Error grew, FAILED");
+    return monotonic && error[1] / reached[1] < error[0] / reached[0];
+}
 
-    const float Get(int y, int x) const{
-        return contents[GetIdx(y, x, n)];
+// Time and error of the banded spline fit on a long handwriting trace for growing segment counts.
+// Every joint must be continuous in position and tangent.
+bool benchmark_spline(){
+    PointBuffer points;
+    for (int i = 0; i < 200000; i++)
+    {
+        const float s = i * 0.001f;
+        points.PushBack(Point(s * 10 + 3 * sinf(s * 2.1f), 5 * cosf(s * 1.3f) + 2 * sinf(s * 4.7f)));
     }
 
-    const Matrix operator*(const Matrix rhs) const{
-        assert(n == rhs.m, "Invalid multiplication!");
-        int N = n;
-        int res_m = m, res_n = rhs.n;
-        vec result; result.reserve(res_m*res_n);
+    bool all_passed = true;
+    for (int segments : {1, 10, 100, 1000, 10000})
+    {
+        const auto start = chrono::steady_clock::now();
+        const vector<Bezier> spline = FitCubicSpline(points, segments);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-        for (int _m = 0; _m < res_m; _m++)
+        float joint_error = 0;
+        for (int j = 0; j + 1 < segments; j++)
         {
-            for (int _n = 0; _n < res_n; _n++)
-            {
-                // Cell _m*res_n + _n
-                int lhs_m = _m;
-                int rhs_n = _n;
-
-                float val = 0;
-                for (int i = 0; i < N; i++)
-                {
-                    float v0 = Get(lhs_m, i);
-                    float v1 = rhs.Get(i, rhs_n);
-                    val += v0*v1;
-                }
-                result.push_back(val);
-            }
+            const Bezier& a = spline[j];
+            const Bezier& b = spline[j+1];
+            joint_error = fmax(joint_error, (a.P3 - b.P0).len());
+            joint_error = fmax(joint_error, ((a.P3 - a.P2) - (b.P1 - b.P0)).len());
         }
-        return Matrix(res_m, res_n, result);
-    }
-
-    // Matrix * Vector(ColumnOriented) = Vector
-    const Vector operator*(const vec rhs) const{
-        const Matrix _rhs(rhs.size(), 1, rhs);
-        return (*this * _rhs).ExtractColumn(0);
+        const bool passed = (int)spline.size() == segments && joint_error < 1e-3f
+            && spline.front().P0.x == points.Front().x && spline.back().P3.y == points.Back().y;
+        all_passed &= passed;
+
+        // Error at the chord length parameter of each point within its segment.
+        ArenaScope scratch;
+        const ArenaVector<double> t(chord_lenght_parameterize<double>(points));
+        double error = 0;
+        for (size_t i = 0; i < points.Size(); i++)
+        {
+            const double u = t[i] * segments;
+            const int j = min((int)u, segments - 1);
+            error += (BezierCubic((float)(u - j), spline[j]) - points[i]).len();
+        }
+        printf("Spline: %5d segments %8.2f ms, mean distance per point %.5f, joints off by %g%s\n", segments, seconds * 1e3,
+            error / points.Size(), joint_error, passed ? "" : "  FAILED");
     }
+    printf("\n");
+    return all_passed;
+}
 
-    const Matrix operator+(const Matrix rhs) const{
-        assert(m == rhs.m, "Matrix dimensions must equal!");
-        assert(n == rhs.n, "Matrix dimensions must equal!");
-
-        vec result; result.reserve(m*n);
-        for (int _m = 0; _m < m; _m++)
+// A zigzag drawn the way a hand does: slowing into every corner, with a few gentle bends at full speed and jitter.
+// Half the corners are mild, only the slowdown gives them away. Every corner must be found and nothing else,
+// without timestamps only the sharp ones, and the stretches between them must not take more pieces than the whole.
+bool benchmark_corners(){
+    const int legs = 40, points_per_leg = 60;
+    PointBuffer points;
+    vector<double> timestamps;
+    vector<size_t> expected = {0};
+    double time = 0;
+    for (int leg = 0; leg < legs; leg++)
+    {
+        const float direction = leg % 2 == 0 ? 0.6f : -0.6f;
+        for (int j = leg == 0 ? 0 : 1; j <= points_per_leg; j++)
         {
-            for (int _n = 0; _n < n; _n++)
-            {
-                result.push_back(Get(_m, _n) + rhs.Get(_m, _n));
-            }
+            const float u = j / (float)points_per_leg;
+            const float along = leg * 2.0f + 2.0f * u;
+            const float bend = 0.15f * sinf(u * 3.14159f); // Gentle, not a corner
+            const float jitter = 0.002f * sinf((float)points.Size() * 12.9898f);
+            points.PushBack(Point(along + jitter, (leg % 2 == 0 ? 0.0f : 1.2f) + direction * 2 * u + bend));
+            // Slow at both ends of a leg, fast in the middle.
+            time += 0.004 + 0.02 * (1 - sinf(u * 3.14159f));
+            timestamps.push_back(time);
         }
-        return Matrix(m, n, result);
+        expected.push_back(points.Size() - 1);
     }
 
-    const Matrix operator-(const Matrix rhs) const{
-        assert(m == rhs.m, "Matrix dimensions must equal!");
-        assert(n == rhs.n, "Matrix dimensions must equal!");
+    const int repetitions = 100;
+    auto start = chrono::steady_clock::now();
+    vector<size_t> corners;
+    for (int r = 0; r < repetitions; r++) corners = FindCorners(points, timestamps.data());
+    const double find_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
+
+    const vector<size_t> sharp_only = FindCorners(points, nullptr);
+    const bool found = corners == expected && includes(expected.begin(), expected.end(), sharp_only.begin(), sharp_only.end());
+    printf("Corners: %zu of %zu found in %.1f us for %zu points, %zu without timestamps, %s\n", corners.size() - 2, expected.size() - 2,
+        find_seconds * 1e6, points.Size(), sharp_only.size() - 2, found ? "OK" : "FAILED");
+
+    const float tolerance = 0.005f;
+    start = chrono::steady_clock::now();
+    const vector<Bezier> whole = FitPiecewiseBezier(points, tolerance);
+    const double whole_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    const vector<Bezier> segmented = FitSegmentedBezier(points, corners, tolerance);
+    const double segmented_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Every corner must be a joint of the segmented fit.
+    size_t next = 1;
+    for (const Bezier& piece : segmented)
+    {
+        if (next + 1 < corners.size() && piece.P3.x == points.X()[corners[next]] && piece.P3.y == points.Y()[corners[next]]) next++;
+    }
+    const bool joints = next + 1 == corners.size();
+    printf("Corners: whole stroke %zu pieces in %.2f ms, cut at corners %zu pieces in %.2f ms%s\n\n", whole.size(), whole_seconds * 1e3,
+        segmented.size(), segmented_seconds * 1e3, joints ? "" : ", corner missing from the joints FAILED");
+    return found && joints && segmented.size() <= whole.size();
+}
 
-        vec result; result.reserve(m*n);
-        for (int _m = 0; _m < m; _m++)
+// main.cpp's filter on a circle in window pixels with tremor, at a few speeds and at 125 Hz and 1 kHz of events:
+// how much of the tremor gets through, against the same filter on the clean circle, how far behind along the
+// circle it runs, and its cost per sample. The tremor must shrink, by half at least when slow, the lag must fall
+// with speed, that being the point of the adaptive cutoff, and must not depend on the event rate.
+bool benchmark_one_euro(){
+    const OneEuroParams params = {1.0f, 0.005f, 1.0f}; // main.cpp's cursorFilter, in window pixels
+    const float radius = 300;
+    const float speeds[] = {100, 500, 2000}; // Pixels per second
+
+    bool all_passed = true;
+    double slow_lag = 0;
+    for (const float speed : speeds)
+    {
+        double lags[2];
+        for (int r = 0; r < 2; r++)
         {
-            for (int _n = 0; _n < n; _n++)
+            const double rate = r == 0 ? 125 : 1000;
+            OneEuroFilter filter(params), clean(params);
+            const int samples = (int)(4 * rate);
+            double raw_jitter = 0, filtered_jitter = 0, lag = 0;
+            int measured = 0;
+            unsigned state = 12345;
+            const auto start = chrono::steady_clock::now();
+            for (int i = 0; i < samples; i++)
             {
-                result.push_back(Get(_m, _n) - rhs.Get(_m, _n));
+                const double time = i / rate;
+                const float angle = (float)(time * speed / radius);
+                const Point truth(radius * cosf(angle), radius * sinf(angle));
+                // Up to a pixel of tremor either way, uncorrelated between events.
+                state = state * 1664525u + 1013904223u;
+                const float jitter_x = (state >> 8) / (float)(1 << 24) * 2 - 1;
+                state = state * 1664525u + 1013904223u;
+                const float jitter_y = (state >> 8) / (float)(1 << 24) * 2 - 1;
+                const Point jitter(jitter_x, jitter_y);
+                const Point out = filter.Filter(truth + jitter, time);
+                const Point reference = clean.Filter(truth, time);
+                if (i < samples / 4) continue; // Settled
+                raw_jitter += jitter.len() * jitter.len();
+                filtered_jitter += (out - reference).len() * (out - reference).len();
+                // Distance back along the circle to where the output is, as time at this speed.
+                const float behind = angle - atan2f(out.y, out.x);
+                lag += remainderf(behind, 2 * 3.14159265f) * radius / speed;
+                measured++;
             }
+            const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / 2;
+
+            raw_jitter = sqrt(raw_jitter / measured);
+            filtered_jitter = sqrt(filtered_jitter / measured);
+            lags[r] = lag / measured;
+            const bool passed = filtered_jitter < (speed == speeds[0] ? 0.5 : 1.0) * raw_jitter;
+            all_passed &= passed;
+            printf("One Euro %4.0f px/s at %4.0f Hz: tremor %.3f -> %.3f px, lag %5.1f ms, %5.1f ns per sample%s\n",
+                speed, rate, raw_jitter, filtered_jitter, lags[r] * 1e3, seconds / samples * 1e9, passed ? "" : "  FAILED");
         }
-        return Matrix(m, n, result);
+        if (speed == speeds[0]) slow_lag = lags[1];
+        const bool rate_independent = fabs(lags[1] - lags[0]) < 0.25 * fmax(lags[0], lags[1]);
+        const bool faster = speed == speeds[0] || lags[1] < 0.75 * slow_lag;
+        all_passed &= rate_independent && faster;
+        if (!rate_independent) printf("One Euro %4.0f px/s: lag depends on the event rate  FAILED\n", speed);
+        if (!faster) printf("One Euro %4.0f px/s: lag no shorter than at %.0f px/s  FAILED\n", speed, speeds[0]);
     }
+    printf("\n");
+    return all_passed;
+}
 
-    const Matrix operator*(const float rhs) const{
-        vec result; result.reserve(m*n);
-        for (int _m = 0; _m < m; _m++)
+// Sessions sampled on every cursor event, slow drawing piles up near duplicates. For each: points removed, the
+// piecewise fit time with and without decimation, and how far the original points end up from the decimated fit.
+bool benchmark_decimation(){
+    const float tolerance = 0.05f; // main.cpp's, in world units
+    DecimateOptions options;
+    options.radial_tolerance = 0.01f;
+    options.rdp_tolerance = 0.01f;
+    options.max_spacing = 0.1f;
+
+    bool all_passed = true;
+    for (const double speed : {0.5, 2.0, 8.0}) // World units per second
+    {
+        // 1 kHz of cursor events along a wobbly path, with hand tremor.
+        PointBuffer session;
+        vector<double> timestamps;
+        for (int i = 0; i < 8000; i++)
         {
-            for (int _n = 0; _n < n; _n++)
-            {
-                result.push_back(Get(_m, _n) * rhs);
-            }
+            const double time = i * 0.001;
+            const float s = (float)(speed * time);
+            session.PushBack(Point(s + 0.3f * sinf(s * 1.7f), 0.8f * sinf(s * 0.9f) + 0.001f * sinf(i * 1.3f)));
+            timestamps.push_back(time);
         }
-        return Matrix(m, n, result);
-    }
 
-    const Matrix operator/(const float rhs) const{
-        float x = 1/rhs;
-        return *this * x;
-    }
+        const int repetitions = 5;
+        auto start = chrono::steady_clock::now();
+        vector<Bezier> pieces;
+        for (int r = 0; r < repetitions; r++) pieces = FitPiecewiseBezier(session, tolerance);
+        const double full_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
 
-    const vec ExtractColumn(const int column) const{
-        assert(column >= 0, "Column must not be negative!");
-        assert(column < n, "Column must be whitin range of matrix!");
-        vec result; result.reserve(m);
-        for (int _m = 0; _m < m; _m++)
+        PointBuffer decimated;
+        size_t removed = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
         {
-            result.push_back(Get(_m, column));
+            decimated = session;
+            removed = Decimate(decimated, options, timestamps.data());
+            pieces = FitPiecewiseBezier(decimated, tolerance);
         }
-        return result;
-    }
+        const double decimated_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
 
-    const vec ExtractRow(const int row) const{
-        assert(row >= 0, "Row must not be negative!");
-        assert(row < m,  "Row must be whitin range of matrix!");
-        vec result; result.reserve(n);
-        for (int _n = 0; _n < n; _n++)
+        // Every original point against its nearest piece.
+        float worst = 0;
+        const size_t n = session.Size();
+        vec distance(n), nearest(n, INFINITY);
+        for (const Bezier& piece : pieces)
         {
-            result.push_back(Get(row, _n));
+            closest_distances(piece, session, distance.data());
+            for (size_t i = 0; i < n; i++) nearest[i] = fmin(nearest[i], distance[i]);
         }
-        return result;
-    }
+        for (float d : nearest) worst = fmax(worst, d);
 
-    const Matrix Insert(const Matrix toInsert, int startCol, int startRow) const{
-        if (startRow < 0) startRow = m - toInsert.m;
-        if (startCol < 0) startCol = n - toInsert.n;
-
-        assert(toInsert.m <= m, "Inserted matrix must be smaller than recipient.");
-        assert(toInsert.n <= n, "Inserted matrix must be smaller than recipient.");
-
-        assert(startRow + toInsert.m <= m, "Inserted matrix must be positioned inside recipient.");
-        assert(startCol + toInsert.n <= n, "Inserted matrix must be positioned inside recipient.");
+        const bool passed = worst <= tolerance + options.rdp_tolerance + options.radial_tolerance;
+        all_passed &= passed;
+        printf("Decimate %4.1f units/s: %4zu of %zu points removed, fit %6.2f ms -> %6.2f ms, %zu pieces, furthest original point %.4f%s\n",
+            speed, removed, n, full_seconds * 1e3, decimated_seconds * 1e3, pieces.size(), worst, passed ? "" : "  FAILED");
+    }
+    printf("\n");
+    return all_passed;
+}
 
-        // If we are gonna override the entire matrix. Dont.
-        if (toInsert.m == m && toInsert.n == n) return toInsert;
+// Angle between the outgoing tangent of a and the incoming one of b, pi when either is degenerate.
+float joint_angle(const Bezier& a, const Bezier& b){
+    const Point in = a.P3 - a.P2, out = b.P1 - b.P0;
+    if (in.len() == 0 || out.len() == 0) return 3.14159265f;
+    return fabsf(atan2f(in.x*out.y - in.y*out.x, in.x*out.x + in.y*out.y));
+}
 
-        vec result(contents); // Clone recipient
-        for (int _m = startRow; _m < startRow + toInsert.m; _m++)
+// Tangent continuous piecewise fits of a wavy stroke split into more and more pieces: the worst kink at a joint
+// and the furthest point before and after, and the time of the joint solve, which has to grow linearly.
+// Every joint must be smooth afterwards, and every piece but the corner's must still be close.
+bool benchmark_tangent_continuous(){
+    bool all_passed = true;
+    for (const int pieces : {50, 500, 5000})
+    {
+        const int per_piece = 20;
+        PointBuffer points;
+        for (int i = 0; i <= pieces * per_piece; i++)
         {
-            for (int _n = startCol; _n < startCol + toInsert.n; _n++)
-            {
-                result[GetIdx(_m, _n, n)] = toInsert.Get(_m - startRow, _n - startCol);
-            }
+            const float s = i / (float)per_piece * 0.25f;
+            // Bounded however long, so float control points keep their precision.
+            points.PushBack(Point(2 * sinf(s * 0.031f) + 0.3f * sinf(s * 2.3f), sinf(s * 1.3f) + 0.2f * cosf(s * 4.1f)));
         }
-        return Matrix(m, n, result);
-    }
-
-    const Matrix Subsection(const int startCol, int endCol, const int startRow, int endRow) const{
-        if (endCol < 0) endCol = n-1;
-        if (endRow < 0) endRow = m-1;
-
-        assert(startCol >= 0, "Column cannot be negative!");
-        assert(startRow >= 0, "Row cannot be negative!");
-
-        assert(endCol < n, "Column must be whitin range!");
-        assert(endRow < m, "Row must be whitin range!");
-
-        assert(startCol <= endCol, "End cannot be before start!");
-        assert(startRow <= endRow, "End cannot be before start!");
 
-        const int M = (endRow - startRow + 1);
-        const int N = (endCol - startCol + 1);
-
-        vec result(M*N, 0);
-        for (int _m = startRow; _m <= endRow; _m++)
+        // Evenly spaced joints, the first is the corner of the piece before, so one joint in the middle stays sharp.
+        vector<size_t> joints;
+        vector<uint8_t> smooth;
+        for (int k = 0; k <= pieces; k++)
         {
-            const int _M = _m - startRow;
-            for (int _n = startCol; _n <= endCol; _n++)
-            {
-                const int _N = _n - startCol;
-                result[GetIdx(_M, _N, N)] = Get(_m, _n);
-            }
+            joints.push_back((size_t)k * per_piece);
+            if (k < pieces) smooth.push_back(k > 0 && k != pieces / 2);
+        }
+        PointBuffer piece;
+        vector<Bezier> separate;
+        for (int k = 0; k < pieces; k++)
+        {
+            piece.Assign(points.X() + joints[k], points.Y() + joints[k], per_piece + 1);
+            separate.push_back(FitCubicBezier(piece));
         }
-        return Matrix(M, N, result);
-    }
 
-    bool IsUpperTriangular() const{
-        for (int _m = 0; _m < m; _m++)
+        float furthest_before = 0;
+        for (int k = 0; k < pieces; k++)
         {
-            for (int _n = 0; _n < n; _n++)
-            {
-                // Under the diagonal is not zero.
-                if (_n < _m && !floatIsZero(Get(_m, _n))) return false;
+            piece.Assign(points.X() + joints[k], points.Y() + joints[k], per_piece + 1);
+            size_t index;
+            furthest_before = fmax(furthest_before, furthest_point(separate[k], piece, &index));
+        }
 
-                // Diagonal cannot be 0.
-                if (_n == _m && floatIsZero(Get(_m, _n))) return false;
-            }
-            
+        // Tight enough that some pieces have to split to stay within it.
+        const float tolerance = 1.5f * furthest_before;
+        TaskPool& pool = TaskPool::Shared();
+        const int repetitions = pieces >= 5000 ? 3 : 20;
+        vector<Bezier> chain;
+        const auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++) chain = fit_tangent_continuous_within(points, joints, smooth, tolerance, FitOptions(), pool);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repetitions;
+
+        // Pieces end on data points, walk them to find each piece's stretch and whether its start is the sharp joint.
+        float kink_before = 0, kink_after = 0, furthest_after = 0;
+        for (int k = 1; k < pieces; k++)
+            if (smooth[k]) kink_before = fmax(kink_before, joint_angle(separate[k-1], separate[k]));
+        size_t first = 0;
+        bool found = !chain.empty();
+        for (size_t k = 0; k < chain.size() && found; k++)
+        {
+            size_t last = first + 1;
+            while (last < points.Size() && !(points[last].x == chain[k].P3.x && points[last].y == chain[k].P3.y)) last++;
+            found = last < points.Size();
+            if (!found) break;
+            if (k > 0 && first != joints[pieces / 2]) kink_after = fmax(kink_after, joint_angle(chain[k-1], chain[k]));
+            piece.Assign(points.X() + first, points.Y() + first, last - first + 1);
+            size_t index;
+            furthest_after = fmax(furthest_after, furthest_point(chain[k], piece, &index));
+            first = last;
         }
-        return true;
+        const bool passed = found && first == points.Size() - 1 && kink_after < 1e-3f && furthest_after <= tolerance;
+        all_passed &= passed;
+        printf("Tangent continuous %4d pieces: %4zu after splits, kink %.4f -> %.6f rad, furthest point %.5f -> %.5f within %.5f, %7.3f ms%s\n",
+            pieces, chain.size(), kink_before, kink_after, furthest_before, furthest_after, tolerance, seconds * 1e3, passed ? "" : "  FAILED");
     }
-};
 
-const Matrix operator*(float lhs, const Matrix rhs){
-    return rhs * lhs;
+    // Through the piecewise fitter, joints where it split and none at the corners.
+    PointBuffer points;
+    vector<size_t> corners = {0};
+    for (int i = 0; i <= 4000; i++)
+    {
+        const float s = i * 0.005f;
+        points.PushBack(Point(s, fabsf(sinf(s)) + 0.1f * sinf(s * 5)));
+        if (i > 0 && i < 4000 && i % 628 == 0) corners.push_back(i); // |sin| kinks at multiples of pi
+    }
+    corners.push_back(points.Size() - 1);
+    FitOptions options;
+    options.tangent_continuous = true;
+    const vector<Bezier> smooth_pieces = FitSegmentedBezier(points, corners, 0.005f, options);
+    float kink = 0, furthest = 0;
+    size_t first = 0;
+    PointBuffer piece;
+    for (size_t k = 0; k < smooth_pieces.size(); k++)
+    {
+        const bool corner = binary_search(corners.begin() + 1, corners.end() - 1, first);
+        if (k > 0 && !corner) kink = fmax(kink, joint_angle(smooth_pieces[k-1], smooth_pieces[k]));
+        size_t last = first + 1;
+        while (last < points.Size() - 1 && !(points[last].x == smooth_pieces[k].P3.x && points[last].y == smooth_pieces[k].P3.y)) last++;
+        piece.Assign(points.X() + first, points.Y() + first, last - first + 1);
+        size_t index;
+        furthest = fmax(furthest, furthest_point(smooth_pieces[k], piece, &index));
+        first = last;
+    }
+    all_passed &= kink < 1e-3f && furthest <= 0.005f;
+    printf("Tangent continuous through FitSegmentedBezier: %zu pieces, %zu corners, worst kink off the corners %.6f rad, furthest point %.5f within 0.005\n\n",
+        smooth_pieces.size(), corners.size() - 2, kink, furthest);
+    return all_passed;
 }
 
-//------------------------------------------------------------------------------------------------
-
-const vector<Point> vector_diff_along_axis0(const vector<Point> points){
-    assert(points.size() >= 2, "Not enough points to calculate diff!");
-
-    vector<Point> result;
-    result.reserve(points.size() - 1);
-    for (size_t i = 0; i < points.size() -1; i++){
-        result.push_back(points[i] - points[i+1]);
+// Split tree on a long twisty stroke with no workers against the shared pool.
+// Every piece must be within tolerance, and the pieces must join end to end.
+bool benchmark_piecewise(){
+    PointBuffer points;
+    for (int i = 0; i < 100000; i++)
+    {
+        const float s = i * 0.0005f;
+        points.PushBack(Point(s * 4 + 2 * cosf(s * 3.1f), 2 * sinf(s * 2.3f) + sinf(s * 7.9f)));
     }
-    return result;
-}
+    const float tolerance = 0.01f;
 
-const vec FrobeniusNorm_for_points_axis1(const vector<Point> points){
-    assert(points.size() >= 2, "Not enough points to calculate FrobeniusNorm!");
+    bool all_passed = true;
+    TaskPool serial(0);
+    size_t serial_pieces = 0;
+    double serial_seconds = 0;
+    for (TaskPool* pool : {&serial, &TaskPool::Shared()})
+    {
+        const auto start = chrono::steady_clock::now();
+        const size_t ends[2] = {0, points.Size() - 1};
+        const vector<Bezier> pieces = fit_piecewise(points, ends, 2, tolerance, FitOptions(), *pool);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        bool joined = pieces.front().P0.x == points.Front().x && pieces.back().P3.y == points.Back().y;
+        for (size_t i = 0; i + 1 < pieces.size(); i++) joined &= pieces[i].P3.x == pieces[i+1].P0.x && pieces[i].P3.y == pieces[i+1].P0.y;
+
+        // Every piece again against the points it was fitted to, found by its end points.
+        float worst = 0;
+        size_t first = 0;
+        for (const Bezier& piece : pieces)
+        {
+            size_t last = first + 1;
+            while (points.X()[last] != piece.P3.x || points.Y()[last] != piece.P3.y) last++;
+            PointBuffer range;
+            range.Assign(points.X() + first, points.Y() + first, last - first + 1);
+            size_t index;
+            worst = fmax(worst, furthest_point(piece, range, &index));
+            first = last;
+        }
 
-    vec result(points.size(), 0);
-    for(size_t i = 0; i < points.size(); i++){
-        result[i] = points[i].len();
+        if (pool == &serial) {
+            serial_pieces = pieces.size();
+            serial_seconds = seconds;
+        }
+        const bool passed = joined && worst <= tolerance && pieces.size() == serial_pieces;
+        all_passed &= passed;
+        printf("Piecewise: %2d workers %8.2f ms, %.1fx, %zu pieces, furthest point %g%s\n", pool->Threads(), seconds * 1e3,
+            serial_seconds / seconds, pieces.size(), worst, passed ? "" : "  FAILED");
     }
-    return result;
+    printf("\n");
+    return all_passed;
 }
 
-const vec float_cumsum(const vec lenghts){
-    assert(lenghts.size() >= 1, "Not enough values to calculate cumsum! At least 1 is required.");
-
-    vec cumsum;
-    cumsum.reserve(lenghts.size());
-    cumsum.push_back(lenghts[0]); // First is unchanged
-
-    // From the second to the last one.
-    for (size_t i = 1; i < lenghts.size(); i++)
+// Time of the tall skinny QR on a long imported path, per thread count, against the single threaded double QR.
+bool benchmark_tsqr(){
+    const size_t m = 500000;
+    PointBuffer points;
+    points.Reserve(m);
+    for (size_t i = 0; i < m; i++)
     {
-        cumsum.push_back(cumsum[i-1] + lenghts[i]);
+        const float s = i / (float)(m - 1);
+        points.PushBack(Point(5000 * s + 300 * sinf(s * 7), 2000 * s*s - 400 * cosf(s * 5)));
     }
-    return cumsum;
-}
 
-const vec chord_lenght_parameterize(const vector<Point> points){
-    assert(points.size() >= 2, "Not enough points to parameterize chord length!");
-
-    const vec chord_lenghts = 
-            FrobeniusNorm_for_points_axis1(
-                vector_diff_along_axis0(points));
-    
-    vec result(float_cumsum(chord_lenghts));
-    result.insert(result.begin(), 0);
-    for (size_t i = 0; i < result.size(); i++)
+    FitOptions serial = {FitSolver::Householder, FitPrecision::Double};
+    serial.parallel_min_points = SIZE_MAX;
+    auto start = chrono::steady_clock::now();
+    const Bezier reference = FitCubicBezier(points, serial);
+    const double serial_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("TSQR: %zu points, serial double QR %.2f ms\n", m, serial_seconds * 1e3);
+
+    bool all_passed = true;
+    // Past the core count too, so the merge tree is exercised on small machines.
+    // Up to the core count more tasks must not be slower than one, with some slack for timer noise.
+    const int cores = (int)max(1u, thread::hardware_concurrency());
+    const int max_threads = max(8, cores);
+    double one_thread_seconds = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
     {
-        result[i] = result[i] / result.back();
+        FitOptions options;
+        options.threads = threads;
+        Bezier b;
+        double seconds = numeric_limits<double>::infinity();
+        for (int r = 0; r < 5; r++)
+        {
+            start = chrono::steady_clock::now();
+            b = FitCubicBezier(points, options);
+            seconds = min(seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        if (threads == 1) one_thread_seconds = seconds;
+        const double speedup = one_thread_seconds / seconds;
+
+        const float deviation = fmax((b.P1 - reference.P1).len(), (b.P2 - reference.P2).len());
+        const bool slower = cores > 1 && threads > 1 && threads <= cores && speedup < 0.9;
+        const bool passed = deviation < 1e-2f && !slower;
+        all_passed &= passed;
+        printf("TSQR: %2d threads %8.2f ms, %.2fx over 1 thread on %d cores, %.1fx over serial QR, control points %g from serial%s\n",
+            threads, seconds * 1e3, speedup, cores, serial_seconds / seconds, deviation, passed ? "" : "  FAILED");
     }
-
-    return result;
+    printf("\n");
+    return all_passed;
 }
 
-//--------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// The auto tuner's dispatch table, every backend against the double QR, and rank deficient strokes that only the SVD solves.
+bool check_solvers(){
+    printf("Solver dispatch%s:", solver_dispatch<float>(FitPrecision::Float).overridden ? " (CF_SOLVER)" : "");
+    for (int i = 0; i < SOLVER_TUNING_SIZE; i++)
+    {
+        printf(" %d: %s/%s/%s", SOLVER_TUNING_POINTS[i], FitSolverName(solver_dispatch<float>(FitPrecision::Float).fastest[i]),
+            FitSolverName(solver_dispatch<double>(FitPrecision::Double).fastest[i]), FitSolverName(solver_dispatch<double>(FitPrecision::Mixed).fastest[i]));
+    }
+    printf(" (float/double/mixed)\n");
 
-const Matrix calculate_householder_matrix(const Vector a){
-    vec _e(a.Size(), 0); 
-    _e[0] = a.Magnitude() * sign(a.Get(0));
-    Vector e(_e);
-    Vector w = (a - e).Normalize();
-    return Matrix::Identity(a.Size()) - 2 * Matrix(w) * Matrix(w, true); 
-}
+    vector<Point> points;
+    for (int i = 0; i < 100; i++) points.push_back(Point(i * 0.5f + sinf(i * 0.1f), cosf(i * 0.07f) * 10));
+    const Bezier reference = FitCubicBezier(points, {FitSolver::Householder, FitPrecision::Double});
 
-const pair<const Matrix, const Matrix> calculate_nextA(const Matrix A, const int iteration){
-    /*
-        x x x x x ...
-        x o o o o ...
-        x o o o o ...
-        x o o o o ...
-        ...
-    */
-    // -1 indicates subsection goes until the end of the row/column
-    const Matrix SubA = A.Subsection(iteration, iteration, iteration, -1);
-    const Vector a = SubA.ExtractColumn(0); // Only extract becouse subsection returns matrix
+    bool all_passed = true;
+    for (FitSolver kind : {FitSolver::NormalEquations, FitSolver::Householder, FitSolver::Givens, FitSolver::SVD, FitSolver::Auto})
+    {
+        for (FitPrecision precision : {FitPrecision::Float, FitPrecision::Double})
+        {
+            const Bezier b = FitCubicBezier(points, {kind, precision});
+            const float deviation = fmax((b.P1 - reference.P1).len(), (b.P2 - reference.P2).len());
+            all_passed &= deviation < 1e-3f;
+            if (deviation >= 1e-3f) printf("Solver %s: control points %g from double QR  MISMATCH\n", FitSolverName(kind), deviation);
+        }
+    }
 
-    const Matrix H = calculate_householder_matrix(a);
-    const Matrix _H = Matrix::Identity(A.m).Insert(H, iteration, iteration);
-    const Matrix _A = _H * A;
-    return make_pair(_A, _H);
+    // Rank 1: the end rows of A are zero. Rank 0: every point but the last is the same.
+    const vector<Point> deficient[] = {
+        {Point(0, 0), Point(1, 2), Point(3, 0)},
+        {Point(1, 1), Point(1, 1), Point(1, 1), Point(1, 1), Point(4, 5)},
+    };
+    // Past parallel_min_points, so the TSQR path: half the points on P0, half on P3, every row of A is zero.
+    vector<Point> repeated(FitOptions().parallel_min_points + 1000, Point(2, 3));
+    fill(repeated.begin() + repeated.size() / 2, repeated.end(), Point(7, -1));
+    for (const vector<Point>& stroke : {deficient[0], deficient[1], repeated})
+    {
+        const Bezier b = FitCubicBezier(stroke);
+        const bool finite = isfinite(b.P1.x) && isfinite(b.P1.y) && isfinite(b.P2.x) && isfinite(b.P2.y);
+        all_passed &= finite;
+        printf("Solver: rank deficient %zu point stroke, P1 (%g, %g) P2 (%g, %g)%s\n", stroke.size(), b.P1.x, b.P1.y, b.P2.x, b.P2.y, finite ? "" : "  FAILED");
+    }
+    printf("\n");
+    return all_passed;
 }
 
-const pair<const Matrix, const Matrix> QR_decomposition(const Matrix A){
-    vector<Matrix> Q_Storage; 
-    Q_Storage.reserve(A.n); 
-    Q_Storage.push_back(Matrix::Identity(A.m));
-
-    vector<Matrix> A_Storage;
-    A_Storage.reserve(A.n); 
-    A_Storage.push_back(A); // Insert first A
-
-    for (int i = 0; i < A.n; i++)
+// IncrementalCubicFit grown one point at a time against a full double QR fit of the same points at every size.
+// The stroke keeps getting longer, so the arc length scale has to be rebased along the way.
+bool check_incremental_fit(){
+    const int count = 2000;
+    PointBuffer points;
+    IncrementalCubicFit incremental;
+    float deviation = 0;
+    for (int i = 0; i < count; i++)
     {
-        // Start the new iteration with the latest A`.
-        auto AQ_Pair = calculate_nextA(A_Storage.back(), i);
-        A_Storage.push_back(AQ_Pair.first);
-        Q_Storage.push_back(Q_Storage.back() * AQ_Pair.second.Transpose());
+        const float s = i * 0.01f;
+        const Point p(s * 3 + sinf(s * 2), cosf(s * 1.5f) * 4 + s);
+        points.PushBack(p);
+        incremental.AddPoint(p);
+        if (points.Size() < 4) continue;
+
+        // Relative to the size of the stroke, control points of a long stroke are far from the origin.
+        const Bezier reference = FitCubicBezier(points, {FitSolver::Householder, FitPrecision::Double});
+        const Bezier current = incremental.Current();
+        const float extent = 1 + (points.Back() - points.Front()).len();
+        deviation = fmax(deviation, fmax((current.P1 - reference.P1).len(), (current.P2 - reference.P2).len()) / extent);
     }
-    return make_pair( Q_Storage.back(), A_Storage.back() );
+    const bool passed = deviation < 1e-5f && incremental.RebaseCount() > 0;
+    printf("Incremental fit: %d points, %zu rebases, control points within %g of the full fit per unit of stroke%s\n\n",
+        count, incremental.RebaseCount(), deviation, passed ? "" : "  FAILED");
+    return passed;
 }
 
-//--------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Strokes per second of the one by one loop against the batch on every ISA.
+bool benchmark_batch(){
+    vector<vector<Point>> strokes;
+    for (int i = 0; i < 4096; i++)
+    {
+        vector<Point> stroke;
+        const int length = 4 + (i * 37) % 60;
+        for (int j = 0; j < length; j++)
+        {
+            const float s = j / (float)(length - 1);
+            stroke.push_back(Point(i + 100 * s + 10 * sinf(s * 4 + i), 50 * s*s + 8 * cosf(s * 3 - i)));
+        }
+        strokes.push_back(stroke);
+    }
+    const int repetitions = 10;
 
-const Vector back_substitution(const Matrix R, const Vector b){
-    assert(R.IsUpperTriangular(), "R must be upper triangular!");
-    assert(R.m == (int)b.Size(), "R must be as tall as b");
-    
-    // rmn * xn = bm => xn = bm / rnm
-    // 
+    auto start = chrono::steady_clock::now();
+    vector<Bezier> reference;
+    for (int r = 0; r < repetitions; r++)
+    {
+        reference.clear();
+        for (const vector<Point>& stroke : strokes) reference.push_back(FitCubicBezier(stroke));
+    }
+    const double loop_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("Batch: one by one   %10.0f strokes/s\n", strokes.size() * repetitions / loop_seconds);
 
-    vec x; 
-    x.reserve(R.n); // x growns backwards,
-    for (int tier = 0; tier < R.n; tier++)
+    bool all_passed = true;
+    const SimdIsa isas[] = {SimdIsa::Scalar, SimdIsa::SSE2, SimdIsa::AVX2, SimdIsa::AVX512};
+    for (SimdIsa isa : isas)
     {
-        int idx = R.n-1-tier;
-        int bIdx = idx;
+        if (!SimdIsaSupported(isa)) continue;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++) fit_batch(SimdKernelsFor(isa), strokes, FitOptions());
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-        // Current Diagonal
-        int Rm = idx;
-        int Rn = idx;
+        const vector<Bezier> batch = fit_batch(SimdKernelsFor(isa), strokes, FitOptions());
 
-        float _x = 0;
-        for (int i = Rn; i < R.n ; i++)
+        float deviation = 0;
+        for (size_t i = 0; i < strokes.size(); i++)
         {
-            // Diagonal, we know this
-            if (i == Rm) {
-                _x += b.Get(bIdx) / R.Get(Rm, Rn);
-                continue;
-            }
-            
-            int curX = idx - i-Rn; 
-            // Previous Xs
-            _x += x[curX];
+            deviation = fmax(deviation, fmax((batch[i].P1 - reference[i].P1).len(), (batch[i].P2 - reference[i].P2).len()));
         }
-        x.push_back(_x);
+        const bool passed = deviation < 1e-2f;
+        all_passed &= passed;
+        printf("Batch: %-12s %10.0f strokes/s, %.1fx, control points %g from one by one%s\n", SimdIsaName(isa),
+            strokes.size() * repetitions / seconds, loop_seconds / seconds, deviation, passed ? "" : "  MISMATCH");
     }
-    return Vector(x).Reverse();
+    printf("\n");
+    return all_passed;
 }
 
-//--------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-
-const Bezier FitCubicBezier(const vector<Point> points){
-    assert(points.size() >= 2, "Not enough points to fit cubic bezier!");
+// Bytes the QR of a fit copies when it takes the design matrix by value, from a pointer, as every
+// Householder fit did before the matrix was moved in. The baseline column of report_copies.
+template<typename T>
+size_t design_matrix_copy(const PointBuffer& points){
+    ArenaScope scratch;
+    const ArenaVector<T> t(chord_lenght_parameterize<T>(points));
+    const CubicFitSystem<T> system = cubic_fit_system(points, t);
+    const size_t before = copied_bytes;
+    const HouseholderQR<T> QR(points.Size(), 2, system.A.data());
+    return copied_bytes - before;
+}
 
-    if (points.size() == 2)
-        return Bezier(points[0],points[0],points[1],points[1]);
-    
-    const vec t(chord_lenght_parameterize(points));
-    const Point P0 = points.front();
-    const Point P3 = points.back();
-    
-    vec _A;    _A.reserve(points.size());
-    vec bx;   bx.reserve(points.size());
-    vec by;   by.reserve(points.size());
-    
-    for (size_t i = 0; i < points.size(); i++)
+// Bytes of Vector/Matrix/QR storage deep copied by a single fit, in every solver and precision, against the same
+// fit with the design matrix copied into its QR. The fit itself should never copy, only the Matrix chains at the
+// end are allowed to.
+bool report_copies(){
+    vector<Point> points;
+    for (int i = 0; i < 255; i++) points.push_back(Point(i * 0.1f, sinf(i * 0.05f)));
+
+    const FitOptions configurations[] = {
+        {FitSolver::NormalEquations, FitPrecision::Float},
+        {FitSolver::Householder, FitPrecision::Float},
+        {FitSolver::Householder, FitPrecision::Double},
+        {FitSolver::Householder, FitPrecision::Mixed},
+    };
+    const char* names[] = {"normal equations", "householder float", "householder double", "householder mixed"};
+    // The normal equations never build a QR, mixed precision factors in float.
+    const PointBuffer packed_points(points);
+    const size_t by_value[] = {0, design_matrix_copy<float>(packed_points), design_matrix_copy<double>(packed_points), design_matrix_copy<float>(packed_points)};
+    size_t fit_copies = 0;
+    for (int c = 0; c < 4; c++)
     {
-        float ti = t[i];
-        float a = 3 * powf(1 - ti, 2) * ti;
-        float b = 3 * (1 - ti) * ti*ti;
-        const Point c = P0 * powf(1 - ti, 3) + P3 * ti*ti*ti;
-        
-        _A.push_back(a);
-        _A.push_back(b);
-        bx.push_back(points[i].x - c.x);
-        by.push_back(points[i].y - c.y);
+        const size_t before = copied_bytes;
+        FitCubicBezier(points, configurations[c]);
+        const size_t copied = copied_bytes - before;
+        fit_copies += copied;
+        printf("Copied by FitCubicBezier, %-18s: %5zu bytes with A copied into the QR, %5zu moved\n", names[c], copied + by_value[c], copied);
     }
-    
-    const Matrix A(points.size(), 2, _A);
-
-    auto QR_Pair = QR_decomposition(A);
-    const Matrix Q = QR_Pair.first;
-    const Matrix R = QR_Pair.second.Subsection(0, 1, 0, 1); // Get the 2x2 upper triangular matrix
-    
-    // R * x = Q^T * bx
-    // R * y = Q^T * by
-    const Matrix QT = Q.Transpose();
-    const Vector QBx = (QT * bx).Subsection(0, 2); // Discard unnesesery part.
-    const Vector QBy = (QT * by).Subsection(0, 2);
-    
-    // R * x = QBx => BackSubstitution
-    // R * y = QBy => BackSubstitution
-    const Vector X = back_substitution(R, QBx);
-    const Vector Y = back_substitution(R, QBy);
 
-
-    return Bezier(P0, Point(X.Get(0), Y.Get(0)), Point(X.Get(1), Y.Get(1)), P3);
+    // Temporaries are reused down the chain, the transpose only relabels the storage.
+    ArenaScope scratch;
+    vec data(64 * 64);
+    for (size_t i = 0; i < data.size(); i++) data[i] = sinf(i * 0.1f);
+    const Matrix A(64, 64, data), B = A.Transpose();
+    size_t before = copied_bytes;
+    Matrix C = (A * B + A - B) * 0.5f;
+    C += A;
+    C = move(C).Transpose();
+    vec w(64, 0.125f);
+    apply_reflector_inplace(Vector(move(w)), C);
+    printf("Copied by a 64x64 Matrix chain: %zu bytes\n\n", copied_bytes - before);
+
+    return fit_copies == 0;
 }
 
-//------------------------------------------------------------------------------------------------
-
-const Point BezierCubic(float t, const Bezier bezier){
-    assert(t >= 0, "T must be in range of [0, 1]");
-    assert(t <= 1, "T must be in range of [0, 1]");
-    
-    const Point P0 = bezier.P0;
-    const Point P1 = bezier.P1;
-    const Point P2 = bezier.P2;
-    const Point P3 = bezier.P3;
+// Counts every heap allocation of the debug build.
+// Atomic, the TSQR and the task pool allocate from their threads too.
+atomic<size_t> malloc_calls(0);
 
-    return  P0 * powf(1-t, 3) +
-    P1 * 3 * powf(1-t, 2) * t +
-    P2 * 3 * (1-t) * t*t +
-    P3 * t*t*t;
+// Out of line, inlined into callers GCC takes the malloc/free pairing for a new/delete mismatch.
+__attribute__((noinline)) void* operator new(size_t size){
+    malloc_calls++;
+    if (void* pointer = malloc(size)) return pointer;
+    throw bad_alloc();
 }
 
-double EvaluateBezier(const Bezier bezier, const vector<Point> points){
-    if (points.size() <= 2) return 0;
-    const vec t(chord_lenght_parameterize(points));
-
-    assert(t.size() == points.size(), "The number of Ts and points do not match.");
-
-    double accumulated_error = 0;
-    for (size_t i = 0; i < points.size(); i++)
+__attribute__((noinline)) void operator delete(void* pointer) noexcept { free(pointer); }
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+
+// Once the arena is warm, fitting must not touch the heap at all.
+bool check_steady_state_allocations(const vector<Point>& points){
+    FitArena& arena = FitArena::ThreadLocal();
+    FitOptions resampled;
+    resampled.resample_count = 32;
+    FitOptions reparameterized;
+    reparameterized.reparameterize_iterations = 3;
+    FitCubicBezier(points); // Warm up
+    FitCubicBezier(points, resampled);
+    FitCubicBezier(points, reparameterized);
+
+    const size_t block_allocations = arena.BlockAllocations();
+    const size_t mallocs_before = malloc_calls;
+    const int fits = 100;
+    for (int i = 0; i < fits; i++)
     {
-        Point evaluated = BezierCubic(t[i], bezier);
-        accumulated_error += (double)(evaluated - points[i]).len();
-    }   
-    return accumulated_error;
-}
-
-//------------------------------------------------------------------------------------------------
-
-
+        EvaluateBezier(FitCubicBezier(points), points);
+        FitCubicBezier(points, {FitSolver::Householder});
+        FitCubicBezier(points, {FitSolver::Householder, FitPrecision::Mixed});
+        FitCubicBezier(points, resampled);
+        FitCubicBezier(points, reparameterized);
+    }
+    const size_t mallocs = malloc_calls - mallocs_before;
 
-#undef vec
-#ifdef DEBUG_CF
+    printf("Arena: %zu blocks, %zu bytes reserved\n", arena.BlockAllocations(), arena.BytesReserved());
+    printf("Steady state: %zu mallocs, %zu new arena blocks over %d fits\n\n", mallocs, arena.BlockAllocations() - block_allocations, fits);
+    return mallocs == 0;
+}
 
 int main(){
+    const auto tuning_start = chrono::steady_clock::now();
+    TuneFitSolvers();
+    printf("Solver tuning: %.1f ms\n\n", chrono::duration<double, milli>(chrono::steady_clock::now() - tuning_start).count());
+    if (!check_simd_kernels()) return 1;
+    if (!benchmark_matmul()) return 1;
+    if (!benchmark_chord_parameterize()) return 1;
+    if (!check_precision_modes()) return 1;
+    if (!check_solvers()) return 1;
+    if (!check_incremental_fit()) return 1;
+    if (!benchmark_batch()) return 1;
+    if (!report_resampled_accuracy()) return 1;
+    if (!report_reparameterization()) return 1;
+    if (!benchmark_closest_point()) return 1;
+    if (!benchmark_tsqr()) return 1;
+    if (!benchmark_spline()) return 1;
+    if (!benchmark_piecewise()) return 1;
+    if (!benchmark_corners()) return 1;
+    if (!benchmark_tangent_continuous()) return 1;
+    if (!benchmark_decimation()) return 1;
+    if (!benchmark_one_euro()) return 1;
+    if (!report_copies()) return 1;
+
     vector<Point> points = {Point(-4.01,-1.7),Point(-3.64,-0.7),Point(-2.8,0.25),Point(-1.36,0.97),Point(0.05,1.52),Point(2.07,1.94),Point(2.89,2.11)};
     //Matrix m(7, 2, v);
+    if (!check_steady_state_allocations(points)) return 1;
+
     Bezier b = FitCubicBezier(points);
     b.P0.DebugDisplay("P0");
     b.P1.DebugDisplay("P1");
@@ -637,4 +3901,6 @@ int main(){
     printf("Error: %lf", error);
 }
 
-#endif
\ No newline at end of file
+#endif
+
+#undef vec
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
 
 struct Point
 {
-    const float x, y;
+    float x = 0, y = 0;
+    Point() = default;
     Point(float x, float y) : x(x), y(y) {};
 
     void DebugDisplay(const char* name) const;
@@ -27,10 +29,240 @@ struct Point
 
 struct Bezier
 {
-    const Point P0, P1, P2, P3;
+    Point P0, P1, P2, P3;
+    Bezier() = default;
     Bezier(Point p0, Point p1, Point p2, Point p3) : P0(p0), P1(p1), P2(p2), P3(p3) {}
 
 };
 
-const Bezier FitCubicBezier(const std::vector<Point> points);
-double EvaluateBezier(const Bezier bezier, const std::vector<Point> points);
\ No newline at end of file
+// Points as separate x and y arrays, 32 byte aligned so loops over them vectorize.
+// Clear keeps the capacity, a buffer reused stroke after stroke stops allocating once it is big enough.
+class PointBuffer
+{
+public:
+    static const std::size_t ALIGNMENT = 32;
+
+    PointBuffer() = default;
+    PointBuffer(const std::vector<Point>& points) { Assign(points); }
+    PointBuffer(const PointBuffer& other) { Assign(other.xs, other.ys, other.count); }
+    PointBuffer(PointBuffer&& other) noexcept;
+    PointBuffer& operator=(const PointBuffer& other);
+    PointBuffer& operator=(PointBuffer&& other) noexcept;
+    ~PointBuffer();
+
+    void Clear() { count = 0; }
+    // Keeps the first new_count points, never grows.
+    void Truncate(std::size_t new_count) { if (new_count < count) count = new_count; }
+    void Reserve(std::size_t new_capacity);
+    void PushBack(const Point p);
+
+    void Assign(const std::vector<Point>& points);
+    void Assign(const float* x, const float* y, std::size_t new_count);
+    // count x, y pairs, the layout of a vertex buffer.
+    void AssignInterleaved(const float* xy, std::size_t new_count);
+
+    std::size_t Size() const { return count; }
+    bool Empty() const { return count == 0; }
+
+    const float* X() const { return xs; }
+    const float* Y() const { return ys; }
+    float* X() { return xs; }
+    float* Y() { return ys; }
+
+    // AoS view of a single point.
+    Point operator[](const std::size_t i) const { return Point(xs[i], ys[i]); }
+    void Set(const std::size_t i, const Point p) { xs[i] = p.x; ys[i] = p.y; }
+    Point Front() const { return (*this)[0]; }
+    Point Back() const { return (*this)[count - 1]; }
+
+private:
+    float* xs = nullptr;
+    float* ys = nullptr;
+    std::size_t count = 0;
+    std::size_t capacity = 0;
+};
+
+// Backend of the least squares solve. A backend that cannot be trusted with a system hands it on to
+// Householder, and a rank deficient one (3 points, repeated points) on to the SVD.
+enum class FitSolver
+{
+    // Accumulates A^T*A and A^T*b in one pass and solves the 2x2 system directly.
+    // Falls back to Householder when the system is ill-conditioned.
+    NormalEquations,
+    Householder,
+    Givens, // Rotates the rows into a triangle in double as they are built, no storage.
+    SVD,    // Jacobi SVD, the only one that handles rank deficient systems.
+    Auto,   // Fastest backend for the point count and precision, timed on this machine, see TuneFitSolvers.
+};
+
+// Scalar type of the fit. The normal equations accumulate in double in every mode.
+enum class FitPrecision
+{
+    Float,  // SIMD kernels throughout.
+    Double, // Chord lengths and QR in double, plain loops.
+    // QR factored in float, the solution refined with residuals computed in double.
+    // Close to double accuracy at close to float speed.
+    Mixed,
+};
+
+const char* FitSolverName(FitSolver solver);
+
+// Backend FitSolver::Auto picks for a stroke of this many points. Float, Double and Mixed are timed separately.
+// Setting the CF_SOLVER environment variable to a FitSolverName forces that backend, for A/B runs.
+FitSolver AutoFitSolver(std::size_t points, FitPrecision precision);
+
+// Times the backends for FitSolver::Auto in every precision now rather than on the first fit that needs them.
+// Blocks for 100 to 150 ms, which would otherwise stall that fit. Call once at startup, before any stroke.
+void TuneFitSolvers();
+
+// Error of the chord length fit and of every reparameterization iteration after it, see FitOptions::report.
+struct FitReport
+{
+    struct Iteration
+    {
+        double error;        // Sum of the distances of the points from the curve at their t
+        double microseconds; // Newton step, refit and error together
+    };
+
+    double chord_error = 0;
+    std::vector<Iteration> iterations;
+};
+
+struct FitOptions
+{
+    FitSolver solver = FitSolver::Auto;
+    FitPrecision precision = FitPrecision::Float;
+
+    // Refinement steps of FitPrecision::Mixed, each gains roughly the digits float loses.
+    int refinement_steps = 2;
+
+    // Largest condition number of A^T*A the normal equations are trusted with.
+    // Squaring the condition of A is what makes them inaccurate, above this QR is used.
+    double normal_equations_max_condition = 1e7;
+
+    // When >= 4 the stroke is first resampled to this many points evenly spaced along its length.
+    // t is then the same for every stroke and the fit is a precomputed pseudo-inverse times the points,
+    // solver and precision are ignored. 16, 32, 64, 128 and 256 are cached, other counts are built per fit.
+    // Fewer than 4 points cannot pin a cubic, so smaller counts leave resampling off.
+    int resample_count = 0;
+
+    // Strokes of at least this many points are fitted with a tall skinny QR split into threads tasks on
+    // TaskPool::Shared, in double whatever the solver and precision. threads = 0 uses every core.
+    std::size_t parallel_min_points = 65536;
+    int threads = 0;
+
+    // Newton-Raphson passes after the chord length fit, each moves every t to the closest point of the curve
+    // and fits again. Stops early once an iteration improves the error by less than reparameterize_min_improvement
+    // (relative), or once reparameterize_budget_us is spent, 0 is no budget.
+    int reparameterize_iterations = 0;
+    double reparameterize_min_improvement = 1e-3;
+    double reparameterize_budget_us = 0;
+
+    // Errors and timings of the reparameterization are appended here when set.
+    FitReport* report = nullptr;
+
+    // FitPiecewiseBezier and FitSegmentedBezier only. Once split, all pieces are fitted again together so that
+    // consecutive pieces leave every joint at the same speed per arc length, C1 and so G1, corners excepted.
+    // Joints stay on their points. A piece the joint solve pushes beyond tolerance is split and the chain solved
+    // again, one still beyond after a few rounds falls back to its unconstrained pieces and loses G1 at their ends.
+    bool tangent_continuous = false;
+};
+
+const Bezier FitCubicBezier(const PointBuffer& points, const FitOptions& options = FitOptions());
+const Bezier FitCubicBezier(const std::vector<Point>& points, const FitOptions& options = FitOptions());
+
+// FitCubicBezier of every stroke, the normal equations of many strokes are set up together, one SIMD lane per stroke.
+const std::vector<Bezier> FitCubicBezierBatch(const std::vector<std::vector<Point>>& strokes, const FitOptions& options = FitOptions());
+// Chain of segments cubic Beziers through the whole stroke, fitted globally in one least squares solve.
+// Joints are C2, the chain starts and ends on the first and last point. Banded, so O(points + segments).
+const std::vector<Bezier> FitCubicSpline(const PointBuffer& points, int segments);
+const std::vector<Bezier> FitCubicSpline(const std::vector<Point>& points, int segments);
+
+// As many cubic Beziers as it takes for every point to be within tolerance of its piece, joined end to end.
+// A piece that is off by more is split at its furthest point and both halves are fitted again,
+// long halves in parallel on the shared TaskPool.
+const std::vector<Bezier> FitPiecewiseBezier(const PointBuffer& points, float tolerance, const FitOptions& options = FitOptions());
+const std::vector<Bezier> FitPiecewiseBezier(const std::vector<Point>& points, float tolerance, const FitOptions& options = FitOptions());
+
+// What FindCorners takes for a corner: a sharp turn, or a milder one where the cursor slows down to a stop.
+struct CornerOptions
+{
+    int window = 2;                     // Points on either side of a point its turning angle is measured over
+    float min_turning_angle = 1.0f;     // Radians, a corner at any speed
+    float slow_turning_angle = 0.5f;    // Radians, a corner at a speed minimum below slow_speed_ratio
+    float slow_speed_ratio = 0.5f;      // Of the median speed of the stroke
+    std::size_t min_spacing = 3;        // Points between corners, of corners closer together the sharpest stays
+};
+
+// Indices of the corners of a stroke in one pass, the first and last point included.
+// timestamps holds the time of every point in seconds, without them (nullptr) only sharp turns count.
+std::vector<std::size_t> FindCorners(const PointBuffer& points, const double* timestamps, const CornerOptions& options = CornerOptions());
+
+// Which points Decimate drops, distances in the units of the points. 0 turns a filter off.
+struct DecimateOptions
+{
+    float radial_tolerance = 0; // Points closer than this to the last point kept
+    float rdp_tolerance = 0;    // Points within this of the segment between the points kept around them
+    float max_spacing = 0;      // Of RDP, kept points are no further apart, so a fit still has points to follow
+};
+
+// Drops redundant points in place ahead of a fit, the first and last point always stay.
+// Radial distance first, one pass that thins out the points of slow drawing, then Ramer-Douglas-Peucker
+// on what is left, with an explicit stack instead of recursion. timestamps, when given, is compacted alike.
+// Returns how many points were removed.
+std::size_t Decimate(PointBuffer& points, const DecimateOptions& options, double* timestamps = nullptr);
+
+// FitPiecewiseBezier of every stretch between two consecutive corners, all stretches in parallel.
+// The pieces meet at the corners without a shared tangent, so a corner stays sharp.
+const std::vector<Bezier> FitSegmentedBezier(const PointBuffer& points, const std::vector<std::size_t>& corners, float tolerance, const FitOptions& options = FitOptions());
+
+// How EvaluateBezier combines the distances of the points from the curve.
+enum class ErrorMetric
+{
+    ChordSum, // Sum of the distances from the curve at each point's chord length t, what the fit minimizes
+    Sum,      // Sum of the distances from the closest point of the curve
+    RMS,      // Root mean square of the closest point distances
+    Max,      // Largest closest point distance, the Hausdorff distance from the points to the curve
+};
+
+double EvaluateBezier(const Bezier bezier, const PointBuffer& points, ErrorMetric metric = ErrorMetric::ChordSum);
+double EvaluateBezier(const Bezier bezier, const std::vector<Point>& points, ErrorMetric metric = ErrorMetric::ChordSum);
+
+// Cubic fit of a stroke that grows one point at a time.
+// Every point is rotated into a small triangular factor with Givens rotations in O(1),
+// so the fit of the stroke so far is available at any time without refactoring.
+class IncrementalCubicFit
+{
+public:
+    IncrementalCubicFit() { Reset(); }
+
+    void Reset();
+    void AddPoint(const Point p);
+
+    // Same result as FitCubicBezier on every point added since Reset (up to rounding), from 4 points on.
+    // With 2 or 3 points it is the straight line Bezier P0 P0 P3 P3, where FitCubicBezier bends through a
+    // middle point with the SVD.
+    const Bezier Current() const;
+
+    std::size_t Size() const { return count; }
+
+    // Chord length t of every point shifts as the stroke grows. That is handled exactly by
+    // storing arc length, so only the scale of the arc length columns is ever rebased.
+    // Rebasing is a column scaling of R, the stroke is never refactored.
+    std::size_t RebaseCount() const { return rebases; }
+
+private:
+    static const int FEATURES = 6; // [1 u u^2 u^3 x y], u = arc length / scale
+
+    double R[FEATURES * FEATURES]; // Upper triangular, row major
+    double scale;  // Arc length of u = 1
+    double length; // Arc length up to the last point
+
+    float first_x, first_y;
+    float last_x, last_y;
+
+    std::size_t count;
+    std::size_t rebases;
+
+    void Rebase(const double new_scale);
+};
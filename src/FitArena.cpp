@@ -0,0 +1,62 @@
+#include "FitArena.hpp"
+
+thread_local FitArena* current_arena = nullptr;
+
+FitArena::~FitArena(){
+    for (const Block& block : blocks)
+    {
+        ::operator delete(block.data, std::align_val_t(ALIGNMENT));
+    }
+}
+
+void* FitArena::Allocate(std::size_t bytes){
+    // Keep every allocation cache line aligned.
+    bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    // Move on to the next kept block that is big enough, skipped space is lost until the rewind.
+    while (current_block < blocks.size() && offset + bytes > blocks[current_block].size)
+    {
+        current_block++;
+        offset = 0;
+    }
+
+    if (current_block == blocks.size()){
+        const std::size_t size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+        char* data = static_cast<char*>(::operator new(size, std::align_val_t(ALIGNMENT)));
+        blocks.push_back({data, size});
+        block_allocations++;
+    }
+
+    void* result = blocks[current_block].data + offset;
+    offset += bytes;
+    return result;
+}
+
+void FitArena::Rewind(const Marker marker){
+    current_block = marker.block;
+    offset = marker.offset;
+}
+
+std::size_t FitArena::BytesReserved() const{
+    std::size_t total = 0;
+    for (const Block& block : blocks) total += block.size;
+    return total;
+}
+
+FitArena* FitArena::Current(){
+    return current_arena;
+}
+
+FitArena& FitArena::ThreadLocal(){
+    thread_local FitArena arena;
+    return arena;
+}
+
+ArenaScope::ArenaScope(FitArena& arena) : arena(arena), previous(current_arena), marker(arena.Mark()){
+    current_arena = &arena;
+}
+
+ArenaScope::~ArenaScope(){
+    arena.Rewind(marker);
+    current_arena = previous;
+}
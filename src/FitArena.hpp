@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for the scratch memory of a fit.
+// Memory is handed out from cache line aligned blocks and given back all at once by rewinding,
+// blocks are kept, so once the arena has grown to the size of a fit no further mallocs happen.
+class FitArena
+{
+public:
+    static const std::size_t ALIGNMENT = 64; // Cache line
+    static const std::size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Marker
+    {
+        std::size_t block;
+        std::size_t offset;
+    };
+
+    FitArena() = default;
+    FitArena(const FitArena&) = delete;
+    FitArena& operator=(const FitArena&) = delete;
+    ~FitArena();
+
+    void* Allocate(std::size_t bytes);
+
+    // O(1), everything allocated after the marker is released.
+    Marker Mark() const { return {current_block, offset}; }
+    void Rewind(const Marker marker);
+    void Reset() { Rewind({0, 0}); }
+
+    // Number of blocks ever malloc'd, constant once the arena is warm.
+    std::size_t BlockAllocations() const { return block_allocations; }
+    std::size_t BytesReserved() const;
+
+    // The arena of the innermost ArenaScope on this thread, nullptr outside of any scope.
+    static FitArena* Current();
+
+    // Default arena of the calling thread.
+    static FitArena& ThreadLocal();
+
+private:
+    struct Block
+    {
+        char* data;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t current_block = 0;
+    std::size_t offset = 0;
+    std::size_t block_allocations = 0;
+
+    friend class ArenaScope;
+};
+
+// Makes an arena current for the calling thread and rewinds it when the scope ends.
+// Nothing allocated inside the scope may outlive it.
+class ArenaScope
+{
+public:
+    ArenaScope() : ArenaScope(FitArena::ThreadLocal()) {}
+    explicit ArenaScope(FitArena& arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    FitArena& arena;
+    FitArena* previous;
+    FitArena::Marker marker;
+};
+
+// Allocates from the current arena, or the heap when there is no ArenaScope.
+// Deallocation into an arena is a no-op, the memory comes back when the scope rewinds.
+template<typename T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::false_type is_always_equal;
+
+    FitArena* arena;
+
+    ArenaAllocator() : arena(FitArena::Current()) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    // Copies belong to whichever scope they are made in.
+    ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+    T* allocate(std::size_t count){
+        if (arena != nullptr) return static_cast<T*>(arena->Allocate(count * sizeof(T)));
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t){
+        if (arena == nullptr) ::operator delete(pointer);
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,217 @@
+#pragma once
+
+// Stack allocated Vector/Matrix with compile time dimensions, float unless another scalar type is given.
+// Used for the small dense part of the fit (R, Q^T * b, back substitution), where the
+// sizes are known up front, so nothing is allocated and every loop can be unrolled.
+namespace fixed
+{
+
+template<int N, typename T = float>
+struct Vector
+{
+    static_assert(N > 0, "Vector size must be bigger than 0");
+
+    T contents[N];
+
+    static constexpr Vector FromData(const T* data){
+        Vector result{};
+        for (int i = 0; i < N; i++)
+        {
+            result.contents[i] = data[i];
+        }
+        return result;
+    }
+
+    static constexpr int Size(){
+        return N;
+    }
+
+    constexpr T Get(const int index) const{
+        return contents[index];
+    }
+
+    constexpr T& operator[](const int index){
+        return contents[index];
+    }
+
+    constexpr Vector operator+(const Vector& rhs) const{
+        Vector result{};
+        for (int i = 0; i < N; i++)
+        {
+            result.contents[i] = contents[i] + rhs.contents[i];
+        }
+        return result;
+    }
+
+    constexpr Vector operator-(const Vector& rhs) const{
+        Vector result{};
+        for (int i = 0; i < N; i++)
+        {
+            result.contents[i] = contents[i] - rhs.contents[i];
+        }
+        return result;
+    }
+
+    constexpr Vector operator*(const T rhs) const{
+        Vector result{};
+        for (int i = 0; i < N; i++)
+        {
+            result.contents[i] = contents[i] * rhs;
+        }
+        return result;
+    }
+
+    constexpr T Dot(const Vector& rhs) const{
+        T result = 0;
+        for (int i = 0; i < N; i++)
+        {
+            result += contents[i] * rhs.contents[i];
+        }
+        return result;
+    }
+};
+
+template<int M, int N, typename T = float>
+struct Matrix
+{
+    static_assert(M > 0 && N > 0, "Matrix size must be bigger than 0");
+
+    static constexpr int m = M, n = N;
+
+    T contents[M*N]; // Row major
+
+    static constexpr Matrix FromData(const T* data){
+        Matrix result{};
+        for (int i = 0; i < M*N; i++)
+        {
+            result.contents[i] = data[i];
+        }
+        return result;
+    }
+
+    static constexpr Matrix Identity(){
+        static_assert(M == N, "Identity must be square");
+        Matrix result{};
+        for (int i = 0; i < N; i++)
+        {
+            // nth row, nth column
+            result.contents[N * i + i] = 1;
+        }
+        return result;
+    }
+
+    static constexpr int GetIdx(const int y, const int x){
+        return y * N + x;
+    }
+
+    constexpr T Get(const int y, const int x) const{
+        return contents[GetIdx(y, x)];
+    }
+
+    constexpr T& operator()(const int y, const int x){
+        return contents[GetIdx(y, x)];
+    }
+
+    constexpr Matrix<N, M, T> Transpose() const{
+        Matrix<N, M, T> result{};
+        for (int _m = 0; _m < M; _m++)
+        {
+            for (int _n = 0; _n < N; _n++)
+            {
+                result.contents[_n*M + _m] = contents[_m*N + _n];
+            }
+        }
+        return result;
+    }
+
+    template<int K>
+    constexpr Matrix<M, K, T> operator*(const Matrix<N, K, T>& rhs) const{
+        Matrix<M, K, T> result{};
+        for (int _m = 0; _m < M; _m++)
+        {
+            for (int i = 0; i < N; i++)
+            {
+                const T v0 = Get(_m, i);
+                for (int _k = 0; _k < K; _k++)
+                {
+                    result.contents[_m*K + _k] += v0 * rhs.Get(i, _k);
+                }
+            }
+        }
+        return result;
+    }
+
+    // Matrix * Vector(ColumnOriented) = Vector
+    constexpr Vector<M, T> operator*(const Vector<N, T>& rhs) const{
+        Vector<M, T> result{};
+        for (int _m = 0; _m < M; _m++)
+        {
+            for (int _n = 0; _n < N; _n++)
+            {
+                result.contents[_m] += Get(_m, _n) * rhs.Get(_n);
+            }
+        }
+        return result;
+    }
+
+    constexpr Matrix operator+(const Matrix& rhs) const{
+        Matrix result{};
+        for (int i = 0; i < M*N; i++)
+        {
+            result.contents[i] = contents[i] + rhs.contents[i];
+        }
+        return result;
+    }
+
+    constexpr Matrix operator-(const Matrix& rhs) const{
+        Matrix result{};
+        for (int i = 0; i < M*N; i++)
+        {
+            result.contents[i] = contents[i] - rhs.contents[i];
+        }
+        return result;
+    }
+
+    constexpr Matrix operator*(const T rhs) const{
+        Matrix result{};
+        for (int i = 0; i < M*N; i++)
+        {
+            result.contents[i] = contents[i] * rhs;
+        }
+        return result;
+    }
+
+    constexpr bool IsUpperTriangular() const{
+        for (int _m = 0; _m < M; _m++)
+        {
+            for (int _n = 0; _n < N; _n++)
+            {
+                // Under the diagonal is not zero.
+                if (_n < _m && Get(_m, _n) != 0) return false;
+
+                // Diagonal cannot be 0.
+                if (_n == _m && Get(_m, _n) == 0) return false;
+            }
+        }
+        return true;
+    }
+};
+
+// R * x = b, R upper triangular.
+// xi = (bi - sum(rij * xj, j > i)) / rii
+template<int N, typename T>
+constexpr Vector<N, T> back_substitution(const Matrix<N, N, T>& R, const Vector<N, T>& b){
+    Vector<N, T> x{};
+    for (int i = N-1; i >= 0; i--)
+    {
+        T _x = b.Get(i);
+        for (int j = i+1; j < N; j++)
+        {
+            _x -= R.Get(i, j) * x.Get(j);
+        }
+        x[i] = _x / R.Get(i, i);
+    }
+    return x;
+}
+
+} // namespace fixed
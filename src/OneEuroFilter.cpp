@@ -0,0 +1,35 @@
+#include "OneEuroFilter.hpp"
+
+#include <math.h>
+
+static const float PI = 3.14159265f;
+
+// Smoothing factor of an exponential low pass with the given cutoff at sample interval dt.
+static float smoothing(const float cutoff, const float dt){
+    const float tau = 1.0f / (2 * PI * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+Point OneEuroFilter::Filter(const Point p, const double time){
+    if (!primed) {
+        primed = true;
+        last_time = time;
+        last_raw = p;
+        value = p;
+        speed = Point(0, 0);
+        return value;
+    }
+    const float dt = (float)(time - last_time);
+    if (!(dt > 0)) return value;
+    last_time = time;
+
+    // Speed of the raw samples, smoothed at the fixed derivative cutoff. Against the last raw sample rather than
+    // the output, whose lag would add to the speed in proportion to the event rate.
+    const float a_speed = smoothing(params.derivative_cutoff, dt);
+    speed = speed + ((p - last_raw) * (1 / dt) - speed) * a_speed;
+    last_raw = p;
+
+    const float cutoff = params.min_cutoff + params.beta * speed.len();
+    value = value + (p - value) * smoothing(cutoff, dt);
+    return value;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CurveFitting.hpp"
+
+// Tuning of OneEuroFilter. Lower min_cutoff removes more jitter when the cursor is slow,
+// higher beta lets the cutoff rise faster with speed, which is what keeps the lag down.
+struct OneEuroParams
+{
+    float min_cutoff = 1.0f;        // Hz, the cutoff at rest
+    float beta = 0.5f;              // Hz of cutoff per unit of speed, units of the points per second
+    float derivative_cutoff = 1.0f; // Hz, of the speed estimate the cutoff follows
+};
+
+// Speed adaptive low pass of a stream of points (the One Euro filter, Casiez et al. 2012).
+// A first order low pass whose cutoff grows with the filtered speed: jitter at low speed is smoothed hard,
+// fast strokes pass almost untouched. O(1) per sample, no allocations.
+class OneEuroFilter
+{
+public:
+    explicit OneEuroFilter(const OneEuroParams& params = OneEuroParams()) : params(params) {}
+
+    // The next sample passes through unfiltered, for the start of a new stroke.
+    void Reset() { primed = false; }
+
+    // Filtered position of p sampled at time seconds. Samples must come in time order,
+    // one at the same time as the last returns the last output.
+    Point Filter(const Point p, double time);
+
+    // May be changed between samples.
+    OneEuroParams params;
+
+private:
+    bool primed = false;
+    double last_time = 0;
+    Point last_raw, value, speed;
+};
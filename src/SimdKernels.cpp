@@ -0,0 +1,1208 @@
+#include "SimdKernels.hpp"
+
+#include <math.h>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SIMD_X86
+#  include <immintrin.h>
+#  define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+//------------------------------------------------------------------------------------------------
+// Shared, defined once per ISA through Dot/Axpy.
+
+template<float (*Dot)(const float*, const float*, std::size_t), void (*Axpy)(float, const float*, float*, std::size_t)>
+void reflector_update_impl(const float* w, float* A, std::size_t n, std::size_t cols, std::size_t column_stride){
+    for (std::size_t c = 0; c < cols; c++)
+    {
+        float* column = A + c * column_stride;
+        Axpy(-2 * Dot(w, column, n), w, column, n);
+    }
+}
+
+template<float (*Dot)(const float*, const float*, std::size_t)>
+void matvec_impl(const float* A, const float* x, float* y, std::size_t m, std::size_t n){
+    for (std::size_t i = 0; i < m; i++)
+    {
+        y[i] = Dot(A + i * n, x, n);
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+// Scalar
+
+float dot_scalar(const float* a, const float* b, std::size_t n){
+    float result = 0;
+    for (std::size_t i = 0; i < n; i++) result += a[i] * b[i];
+    return result;
+}
+
+void axpy_scalar(float alpha, const float* x, float* y, std::size_t n){
+    for (std::size_t i = 0; i < n; i++) y[i] += alpha * x[i];
+}
+
+void add_scalar(const float* a, const float* b, float* out, std::size_t n){
+    for (std::size_t i = 0; i < n; i++) out[i] = a[i] + b[i];
+}
+
+void sub_scalar(const float* a, const float* b, float* out, std::size_t n){
+    for (std::size_t i = 0; i < n; i++) out[i] = a[i] - b[i];
+}
+
+void scale_scalar(const float* a, float alpha, float* out, std::size_t n){
+    for (std::size_t i = 0; i < n; i++) out[i] = a[i] * alpha;
+}
+
+void gemm_micro_scalar(std::size_t k, const float* a_panel, const float* b_panel, float* tile){
+    float acc[GEMM_MR * GEMM_NR] = {0};
+    for (std::size_t p = 0; p < k; p++)
+    {
+        const float* a = a_panel + p * GEMM_MR;
+        const float* b = b_panel + p * GEMM_NR;
+        for (int i = 0; i < GEMM_MR; i++)
+        {
+            for (int j = 0; j < GEMM_NR; j++) acc[i * GEMM_NR + j] += a[i] * b[j];
+        }
+    }
+    for (int i = 0; i < GEMM_MR * GEMM_NR; i++) tile[i] = acc[i];
+}
+
+// One lane after the other, the reference the vector versions are measured against.
+void fit_batch_scalar(const float* x, const float* y, const int* count, std::size_t max_count, float* sums){
+    const int L = FIT_BATCH_LANES;
+    for (int l = 0; l < L; l++)
+    {
+        const int n = count[l] < (int)max_count ? count[l] : (int)max_count;
+        float acc[FIT_BATCH_SUMS] = {0};
+        if (n > 0) {
+            float total = 0;
+            for (int i = 1; i < n; i++)
+            {
+                const float dx = x[i*L + l] - x[(i-1)*L + l], dy = y[i*L + l] - y[(i-1)*L + l];
+                total += sqrtf(dx*dx + dy*dy);
+            }
+            const float end_x = x[(n-1)*L + l], end_y = y[(n-1)*L + l];
+            const float inv_total = 1 / total;
+
+            float length = 0;
+            for (int i = 0; i < n; i++)
+            {
+                if (i > 0) {
+                    const float dx = x[i*L + l] - x[(i-1)*L + l], dy = y[i*L + l] - y[(i-1)*L + l];
+                    length += sqrtf(dx*dx + dy*dy);
+                }
+                const float t = length * inv_total, s = 1 - t;
+                const float a = 3*s*s*t, b = 3*s*t*t;
+                const float rx = x[i*L + l] - end_x*t*t*t, ry = y[i*L + l] - end_y*t*t*t;
+                acc[0] += a*a; acc[1] += a*b; acc[2] += b*b;
+                acc[3] += a*rx; acc[4] += b*rx;
+                acc[5] += a*ry; acc[6] += b*ry;
+            }
+        }
+        for (int k = 0; k < FIT_BATCH_SUMS; k++) sums[k*L + l] = acc[k];
+    }
+}
+
+// t[0] = 0, t[n-1] = 1 exactly.
+template<void (*Scale)(const float*, float, float*, std::size_t)>
+void normalize_chord(float* t, std::size_t n){
+    Scale(t, 1 / t[n-1], t, n);
+    t[0] = 0;
+    t[n-1] = 1;
+}
+
+template<bool Wide>
+void chord_parameterize_scalar(const float* x, const float* y, std::size_t n, float* t){
+    typename std::conditional<Wide, double, float>::type length = 0;
+    t[0] = 0;
+    for (std::size_t i = 1; i < n; i++)
+    {
+        const float dx = x[i] - x[i-1], dy = y[i] - y[i-1];
+        length += sqrtf(dx*dx + dy*dy);
+        t[i] = (float)length;
+    }
+    normalize_chord<scale_scalar>(t, n);
+}
+
+// Power basis of the cubic, Q(t) = c0 + c1*t + c2*t^2 + c3*t^3 for x then y, from P0..P3 as x, y pairs.
+struct CubicPolynomial
+{
+    float x[4], y[4];
+
+    explicit CubicPolynomial(const float* control){
+        for (int k = 0; k < 2; k++)
+        {
+            const float p0 = control[k], p1 = control[2 + k], p2 = control[4 + k], p3 = control[6 + k];
+            float* c = k == 0 ? x : y;
+            c[0] = p0;
+            c[1] = 3 * (p1 - p0);
+            c[2] = 3 * (p2 - 2*p1 + p0);
+            c[3] = p3 - 3*p2 + 3*p1 - p0;
+        }
+    }
+};
+
+// Newton step of one t, shared by the scalar kernel and the tails of the SSE2/AVX2 ones.
+inline float newton_step(const CubicPolynomial& q, float px, float py, float t){
+    const float dx = q.x[0] + t*(q.x[1] + t*(q.x[2] + t*q.x[3])) - px;
+    const float dy = q.y[0] + t*(q.y[1] + t*(q.y[2] + t*q.y[3])) - py;
+    const float d1x = q.x[1] + t*(2*q.x[2] + 3*q.x[3]*t), d1y = q.y[1] + t*(2*q.y[2] + 3*q.y[3]*t);
+    const float d2x = 2*q.x[2] + 6*q.x[3]*t, d2y = 2*q.y[2] + 6*q.y[3]*t;
+    const float numerator = dx*d1x + dy*d1y;
+    const float denominator = d1x*d1x + d1y*d1y + dx*d2x + dy*d2y;
+    // Only towards a minimum of the distance, a non-positive second derivative would head for a maximum.
+    if (denominator > 0) t -= numerator / denominator;
+    return fminf(fmaxf(t, 0.0f), 1.0f);
+}
+
+void bezier_newton_scalar(const float* control, const float* x, const float* y, float* t, std::size_t n){
+    const CubicPolynomial q(control);
+    for (std::size_t i = 0; i < n; i++) t[i] = newton_step(q, x[i], y[i], t[i]);
+}
+// Closest point: the distance to p is smallest where f(t) = (Q(t) - p).Q'(t), a quintic, crosses zero upwards.
+// f is kept in Bernstein form on DISTANCE_SPANS equal spans of t. The sign changes of a span's coefficients
+// bound its roots: none means no root, one means exactly one, more are split in half until they resolve.
+static const int DISTANCE_SPANS = 8;
+static const int DISTANCE_NEWTON_STEPS = 10;
+static const int DISTANCE_MAX_DEPTH = 12;
+
+// Power basis coefficients of c(a + h*u) in u.
+void shift_polynomial(const double* c, int degree, double a, double h, double* out){
+    for (int k = 0; k <= degree; k++) out[k] = 0;
+    for (int i = degree; i >= 0; i--)
+    {
+        for (int k = degree; k > 0; k--) out[k] = out[k]*a + out[k-1]*h;
+        out[0] = out[0]*a + c[i];
+    }
+}
+
+// The cubic relative to P0, and per span f = g - px*dx - py*dy with g = Q.Q' and dx, dy = Q' raised to degree 5,
+// so the Bernstein coefficients of f for a point take 2 multiply adds each.
+struct DistanceSpans
+{
+    CubicPolynomial q;
+    float origin_x, origin_y;
+    float g[DISTANCE_SPANS][6], dx[DISTANCE_SPANS][6], dy[DISTANCE_SPANS][6];
+
+    explicit DistanceSpans(const float* control) : q(control), origin_x(control[0]), origin_y(control[1]){
+        q.x[0] = q.y[0] = 0;
+
+        double gp[6] = {}, dxp[6] = {}, dyp[6] = {};
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 1; j < 4; j++) gp[i + j-1] += j * ((double)q.x[i]*q.x[j] + (double)q.y[i]*q.y[j]);
+        }
+        for (int j = 1; j < 4; j++) { dxp[j-1] = j * (double)q.x[j]; dyp[j-1] = j * (double)q.y[j]; }
+
+        const double binomial[6][6] = {{1}, {1, 1}, {1, 2, 1}, {1, 3, 3, 1}, {1, 4, 6, 4, 1}, {1, 5, 10, 10, 5, 1}};
+        for (int s = 0; s < DISTANCE_SPANS; s++)
+        {
+            const double* power[3] = {gp, dxp, dyp};
+            float* bernstein[3] = {g[s], dx[s], dy[s]};
+            for (int k = 0; k < 3; k++)
+            {
+                double local[6];
+                shift_polynomial(power[k], 5, s / (double)DISTANCE_SPANS, 1.0 / DISTANCE_SPANS, local);
+                for (int j = 0; j <= 5; j++)
+                {
+                    double b = 0;
+                    for (int i = 0; i <= j; i++) b += binomial[j][i] / binomial[5][i] * local[i];
+                    bernstein[k][j] = (float)b;
+                }
+            }
+        }
+    }
+};
+
+inline float distance_squared(const CubicPolynomial& q, float px, float py, float t){
+    const float dx = q.x[0] + t*(q.x[1] + t*(q.x[2] + t*q.x[3])) - px;
+    const float dy = q.y[0] + t*(q.y[1] + t*(q.y[2] + t*q.y[3])) - py;
+    return dx*dx + dy*dy;
+}
+
+// Root of f in [lo, hi] where f(lo) <= 0 < f(hi). Newton steps from the middle, a step that leaves the
+// bracket bisects instead. Landing on the bracket is allowed, a converged t lands there every step. The distance is flat at the root, so its error is second order in t's.
+inline float distance_root(const CubicPolynomial& q, float px, float py, float lo, float hi){
+    float t = 0.5f * (lo + hi);
+    for (int k = 0; k < DISTANCE_NEWTON_STEPS; k++)
+    {
+        const float dx = q.x[0] + t*(q.x[1] + t*(q.x[2] + t*q.x[3])) - px;
+        const float dy = q.y[0] + t*(q.y[1] + t*(q.y[2] + t*q.y[3])) - py;
+        const float d1x = q.x[1] + t*(2*q.x[2] + 3*q.x[3]*t), d1y = q.y[1] + t*(2*q.y[2] + 3*q.y[3]*t);
+        const float d2x = 2*q.x[2] + 6*q.x[3]*t, d2y = 2*q.y[2] + 6*q.y[3]*t;
+        const float f = dx*d1x + dy*d1y;
+        const float df = d1x*d1x + d1y*d1y + dx*d2x + dy*d2y;
+        if (f <= 0) lo = t;
+        else hi = t;
+        const float newton = t - f / df;
+        const float next = df > 0 && newton >= lo && newton <= hi ? newton : 0.5f * (lo + hi);
+        if (next == t) break; // Converged
+        t = next;
+    }
+    return t;
+}
+
+// Smallest squared distance at the roots of f in [lo, hi], b holds f's Bernstein coefficients there.
+// Also what the vector kernels fall back to for the lanes whose span has more than one sign change.
+float closest_in_span(const CubicPolynomial& q, float px, float py, const float* b, float lo, float hi, int depth){
+    int changes = 0;
+    for (int j = 0; j < 5; j++) changes += (b[j] > 0) != (b[j+1] > 0);
+    if (changes == 0) return INFINITY;
+    if (changes == 1) {
+        if (b[0] > 0) return INFINITY; // f falls through zero, a furthest point
+        return distance_squared(q, px, py, distance_root(q, px, py, lo, hi));
+    }
+    // Rounding noise in coefficients near zero can keep the count ambiguous, polish what is left as is.
+    if (depth == DISTANCE_MAX_DEPTH) {
+        if (b[0] <= 0 && b[5] > 0) return distance_squared(q, px, py, distance_root(q, px, py, lo, hi));
+        return fminf(distance_squared(q, px, py, lo), distance_squared(q, px, py, hi));
+    }
+    const float middle = 0.5f * (lo + hi);
+
+    // de Casteljau at the middle
+    float w[6], left[6], right[6];
+    for (int j = 0; j < 6; j++) w[j] = b[j];
+    for (int r = 0; r < 6; r++)
+    {
+        left[r] = w[0];
+        right[5 - r] = w[5 - r];
+        for (int j = 0; j < 5 - r; j++) w[j] = 0.5f * (w[j] + w[j+1]);
+    }
+    return fminf(closest_in_span(q, px, py, left, lo, middle, depth + 1), closest_in_span(q, px, py, right, middle, hi, depth + 1));
+}
+
+// Shared by the scalar kernel and the tails of the SSE2/AVX2 ones.
+inline float closest_distance(const DistanceSpans& spans, float px, float py){
+    px -= spans.origin_x;
+    py -= spans.origin_y;
+    float best = fminf(distance_squared(spans.q, px, py, 0), distance_squared(spans.q, px, py, 1));
+    for (int s = 0; s < DISTANCE_SPANS; s++)
+    {
+        float b[6];
+        for (int j = 0; j < 6; j++) b[j] = spans.g[s][j] - px*spans.dx[s][j] - py*spans.dy[s][j];
+        best = fminf(best, closest_in_span(spans.q, px, py, b, s / (float)DISTANCE_SPANS, (s + 1) / (float)DISTANCE_SPANS, 0));
+    }
+    return sqrtf(best);
+}
+
+// Lanes of a span whose coefficients change sign exactly once, upwards, from the sign bits of its 6 coefficients.
+// Lanes that change more than once go to ambiguous.
+inline unsigned rising_lanes(const unsigned* positive, unsigned* ambiguous){
+    unsigned seen = 0, multiple = 0;
+    for (int j = 0; j < 5; j++)
+    {
+        const unsigned change = positive[j] ^ positive[j+1];
+        multiple |= seen & change;
+        seen |= change;
+    }
+    *ambiguous = multiple;
+    return seen & ~multiple & ~positive[0] & positive[5];
+}
+
+void bezier_distance_scalar(const float* control, const float* x, const float* y, float* distance, std::size_t n){
+    const DistanceSpans spans(control);
+    for (std::size_t i = 0; i < n; i++) distance[i] = closest_distance(spans, x[i], y[i]);
+}
+
+#ifdef SIMD_X86
+//------------------------------------------------------------------------------------------------
+// SSE2
+
+TARGET("sse2") float dot_sse2(const float* a, const float* b, std::size_t n){
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc0);
+    float result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) result += a[i] * b[i];
+    return result;
+}
+
+TARGET("sse2") void axpy_sse2(float alpha, const float* x, float* y, std::size_t n){
+    const __m128 a = _mm_set1_ps(alpha);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a, _mm_loadu_ps(x + i))));
+    }
+    for (; i < n; i++) y[i] += alpha * x[i];
+}
+
+TARGET("sse2") void add_sse2(const float* a, const float* b, float* out, std::size_t n){
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    for (; i < n; i++) out[i] = a[i] + b[i];
+}
+
+TARGET("sse2") void sub_sse2(const float* a, const float* b, float* out, std::size_t n){
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(out + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    for (; i < n; i++) out[i] = a[i] - b[i];
+}
+
+TARGET("sse2") void scale_sse2(const float* a, float alpha, float* out, std::size_t n){
+    const __m128 s = _mm_set1_ps(alpha);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), s));
+    for (; i < n; i++) out[i] = a[i] * alpha;
+}
+
+// 4 rows x 2 registers of accumulators.
+TARGET("sse2") void gemm_micro_sse2(std::size_t k, const float* a_panel, const float* b_panel, float* tile){
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    for (std::size_t p = 0; p < k; p++)
+    {
+        const __m128 b0 = _mm_loadu_ps(b_panel + p * GEMM_NR);
+        const __m128 b1 = _mm_loadu_ps(b_panel + p * GEMM_NR + 4);
+        const float* a = a_panel + p * GEMM_MR;
+        __m128 ai = _mm_set1_ps(a[0]); c00 = _mm_add_ps(c00, _mm_mul_ps(ai, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(ai, b1));
+        ai = _mm_set1_ps(a[1]);        c10 = _mm_add_ps(c10, _mm_mul_ps(ai, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(ai, b1));
+        ai = _mm_set1_ps(a[2]);        c20 = _mm_add_ps(c20, _mm_mul_ps(ai, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(ai, b1));
+        ai = _mm_set1_ps(a[3]);        c30 = _mm_add_ps(c30, _mm_mul_ps(ai, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(ai, b1));
+    }
+    _mm_storeu_ps(tile,      c00); _mm_storeu_ps(tile + 4,  c01);
+    _mm_storeu_ps(tile + 8,  c10); _mm_storeu_ps(tile + 12, c11);
+    _mm_storeu_ps(tile + 16, c20); _mm_storeu_ps(tile + 20, c21);
+    _mm_storeu_ps(tile + 24, c30); _mm_storeu_ps(tile + 28, c31);
+}
+
+// 4 lanes per register, masks are all ones while i < count.
+// Lanes with no points divide by a zero length, masking a, b and the residuals keeps their sums 0.
+TARGET("sse2") void fit_batch_sse2(const float* x, const float* y, const int* count, std::size_t max_count, float* sums){
+    const int L = FIT_BATCH_LANES;
+    for (int l = 0; l < L; l += 4)
+    {
+        const __m128i n = _mm_loadu_si128((const __m128i*)(count + l));
+        __m128 acc[FIT_BATCH_SUMS];
+        for (int k = 0; k < FIT_BATCH_SUMS; k++) acc[k] = _mm_setzero_ps();
+
+        // Pass 1: total length and the last point of every lane.
+        __m128 total = _mm_setzero_ps();
+        __m128 end_x = _mm_loadu_ps(x + l), end_y = _mm_loadu_ps(y + l);
+        for (std::size_t i = 1; i < max_count; i++)
+        {
+            const __m128 mask = _mm_castsi128_ps(_mm_cmpgt_epi32(n, _mm_set1_epi32((int)i)));
+            const __m128 xi = _mm_loadu_ps(x + i*L + l), yi = _mm_loadu_ps(y + i*L + l);
+            const __m128 dx = _mm_sub_ps(xi, _mm_loadu_ps(x + (i-1)*L + l));
+            const __m128 dy = _mm_sub_ps(yi, _mm_loadu_ps(y + (i-1)*L + l));
+            const __m128 segment = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+            total = _mm_add_ps(total, _mm_and_ps(mask, segment));
+            end_x = _mm_or_ps(_mm_and_ps(mask, xi), _mm_andnot_ps(mask, end_x));
+            end_y = _mm_or_ps(_mm_and_ps(mask, yi), _mm_andnot_ps(mask, end_y));
+        }
+        const __m128 inv_total = _mm_div_ps(_mm_set1_ps(1), total);
+
+        // Pass 2: t of every point and the rows of the system.
+        const __m128 one = _mm_set1_ps(1), three = _mm_set1_ps(3);
+        __m128 length = _mm_setzero_ps();
+        for (std::size_t i = 0; i < max_count; i++)
+        {
+            const __m128 mask = _mm_castsi128_ps(_mm_cmpgt_epi32(n, _mm_set1_epi32((int)i)));
+            const __m128 xi = _mm_loadu_ps(x + i*L + l), yi = _mm_loadu_ps(y + i*L + l);
+            if (i > 0) {
+                const __m128 dx = _mm_sub_ps(xi, _mm_loadu_ps(x + (i-1)*L + l));
+                const __m128 dy = _mm_sub_ps(yi, _mm_loadu_ps(y + (i-1)*L + l));
+                length = _mm_add_ps(length, _mm_and_ps(mask, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)))));
+            }
+            const __m128 t = _mm_mul_ps(length, inv_total), s = _mm_sub_ps(one, t);
+            const __m128 a = _mm_and_ps(mask, _mm_mul_ps(three, _mm_mul_ps(_mm_mul_ps(s, s), t)));
+            const __m128 b = _mm_and_ps(mask, _mm_mul_ps(three, _mm_mul_ps(_mm_mul_ps(t, t), s)));
+            const __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+            const __m128 rx = _mm_and_ps(mask, _mm_sub_ps(xi, _mm_mul_ps(end_x, t3)));
+            const __m128 ry = _mm_and_ps(mask, _mm_sub_ps(yi, _mm_mul_ps(end_y, t3)));
+            acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(a, a));
+            acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(a, b));
+            acc[2] = _mm_add_ps(acc[2], _mm_mul_ps(b, b));
+            acc[3] = _mm_add_ps(acc[3], _mm_mul_ps(a, rx));
+            acc[4] = _mm_add_ps(acc[4], _mm_mul_ps(b, rx));
+            acc[5] = _mm_add_ps(acc[5], _mm_mul_ps(a, ry));
+            acc[6] = _mm_add_ps(acc[6], _mm_mul_ps(b, ry));
+        }
+        for (int k = 0; k < FIT_BATCH_SUMS; k++) _mm_storeu_ps(sums + k*L + l, acc[k]);
+    }
+}
+
+// Inclusive prefix sum of the 4 lanes.
+TARGET("sse2") __m128 prefix_sum_sse2(__m128 v){
+    v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+    v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+    return v;
+}
+
+// Segment lengths of 4 points at a time, summed in registers. The narrow version carries the sum
+// in a broadcast float register, the wide one in a double.
+template<bool Wide>
+TARGET("sse2") void chord_parameterize_sse2(const float* x, const float* y, std::size_t n, float* t){
+    t[0] = 0;
+    __m128 carry = _mm_setzero_ps();
+    double wide_carry = 0;
+    std::size_t i = 1;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(x + i - 1));
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(y + i - 1));
+        const __m128 sum = prefix_sum_sse2(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+        if (Wide) {
+            float lanes[4];
+            _mm_storeu_ps(lanes, sum);
+            for (int l = 0; l < 4; l++) t[i + l] = (float)(wide_carry + lanes[l]);
+            wide_carry += lanes[3];
+        }
+        else {
+            const __m128 cumulative = _mm_add_ps(carry, sum);
+            _mm_storeu_ps(t + i, cumulative);
+            carry = _mm_shuffle_ps(cumulative, cumulative, 0xFF);
+        }
+    }
+    typename std::conditional<Wide, double, float>::type length = Wide ? wide_carry : _mm_cvtss_f32(carry);
+    for (; i < n; i++)
+    {
+        const float dx = x[i] - x[i-1], dy = y[i] - y[i-1];
+        length += sqrtf(dx*dx + dy*dy);
+        t[i] = (float)length;
+    }
+    normalize_chord<scale_sse2>(t, n);
+}
+
+TARGET("sse2") void bezier_newton_sse2(const float* control, const float* x, const float* y, float* t, std::size_t n){
+    const CubicPolynomial q(control);
+    __m128 cx[4], cy[4];
+    for (int k = 0; k < 4; k++) { cx[k] = _mm_set1_ps(q.x[k]); cy[k] = _mm_set1_ps(q.y[k]); }
+    const __m128 two = _mm_set1_ps(2), three = _mm_set1_ps(3), six = _mm_set1_ps(6);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 ti = _mm_loadu_ps(t + i);
+        const __m128 dx = _mm_sub_ps(_mm_add_ps(cx[0], _mm_mul_ps(ti, _mm_add_ps(cx[1], _mm_mul_ps(ti, _mm_add_ps(cx[2], _mm_mul_ps(ti, cx[3])))))), _mm_loadu_ps(x + i));
+        const __m128 dy = _mm_sub_ps(_mm_add_ps(cy[0], _mm_mul_ps(ti, _mm_add_ps(cy[1], _mm_mul_ps(ti, _mm_add_ps(cy[2], _mm_mul_ps(ti, cy[3])))))), _mm_loadu_ps(y + i));
+        const __m128 d1x = _mm_add_ps(cx[1], _mm_mul_ps(ti, _mm_add_ps(_mm_mul_ps(two, cx[2]), _mm_mul_ps(_mm_mul_ps(three, cx[3]), ti))));
+        const __m128 d1y = _mm_add_ps(cy[1], _mm_mul_ps(ti, _mm_add_ps(_mm_mul_ps(two, cy[2]), _mm_mul_ps(_mm_mul_ps(three, cy[3]), ti))));
+        const __m128 d2x = _mm_add_ps(_mm_mul_ps(two, cx[2]), _mm_mul_ps(_mm_mul_ps(six, cx[3]), ti));
+        const __m128 d2y = _mm_add_ps(_mm_mul_ps(two, cy[2]), _mm_mul_ps(_mm_mul_ps(six, cy[3]), ti));
+        const __m128 numerator = _mm_add_ps(_mm_mul_ps(dx, d1x), _mm_mul_ps(dy, d1y));
+        const __m128 denominator = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d1x, d1x), _mm_mul_ps(d1y, d1y)), _mm_add_ps(_mm_mul_ps(dx, d2x), _mm_mul_ps(dy, d2y)));
+        const __m128 step = _mm_and_ps(_mm_cmpgt_ps(denominator, zero), _mm_div_ps(numerator, denominator));
+        _mm_storeu_ps(t + i, _mm_min_ps(_mm_max_ps(_mm_sub_ps(ti, step), zero), one));
+    }
+    for (; i < n; i++) t[i] = newton_step(q, x[i], y[i], t[i]);
+}
+
+TARGET("sse2") __m128 distance_squared_sse2(const __m128* cx, const __m128* cy, __m128 px, __m128 py, __m128 t){
+    const __m128 dx = _mm_sub_ps(_mm_mul_ps(t, _mm_add_ps(cx[1], _mm_mul_ps(t, _mm_add_ps(cx[2], _mm_mul_ps(t, cx[3]))))), px);
+    const __m128 dy = _mm_sub_ps(_mm_mul_ps(t, _mm_add_ps(cy[1], _mm_mul_ps(t, _mm_add_ps(cy[2], _mm_mul_ps(t, cy[3]))))), py);
+    return _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+}
+
+// distance_root on 4 lanes, relative to P0 so c0 is 0.
+TARGET("sse2") __m128 distance_root_sse2(const __m128* cx, const __m128* cy, __m128 px, __m128 py, __m128 lo, __m128 hi){
+    const __m128 two = _mm_set1_ps(2), three = _mm_set1_ps(3), six = _mm_set1_ps(6), half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 t = _mm_mul_ps(half, _mm_add_ps(lo, hi));
+    for (int k = 0; k < DISTANCE_NEWTON_STEPS; k++)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_mul_ps(t, _mm_add_ps(cx[1], _mm_mul_ps(t, _mm_add_ps(cx[2], _mm_mul_ps(t, cx[3]))))), px);
+        const __m128 dy = _mm_sub_ps(_mm_mul_ps(t, _mm_add_ps(cy[1], _mm_mul_ps(t, _mm_add_ps(cy[2], _mm_mul_ps(t, cy[3]))))), py);
+        const __m128 d1x = _mm_add_ps(cx[1], _mm_mul_ps(t, _mm_add_ps(_mm_mul_ps(two, cx[2]), _mm_mul_ps(_mm_mul_ps(three, cx[3]), t))));
+        const __m128 d1y = _mm_add_ps(cy[1], _mm_mul_ps(t, _mm_add_ps(_mm_mul_ps(two, cy[2]), _mm_mul_ps(_mm_mul_ps(three, cy[3]), t))));
+        const __m128 d2x = _mm_add_ps(_mm_mul_ps(two, cx[2]), _mm_mul_ps(_mm_mul_ps(six, cx[3]), t));
+        const __m128 d2y = _mm_add_ps(_mm_mul_ps(two, cy[2]), _mm_mul_ps(_mm_mul_ps(six, cy[3]), t));
+        const __m128 f = _mm_add_ps(_mm_mul_ps(dx, d1x), _mm_mul_ps(dy, d1y));
+        const __m128 df = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d1x, d1x), _mm_mul_ps(d1y, d1y)), _mm_add_ps(_mm_mul_ps(dx, d2x), _mm_mul_ps(dy, d2y)));
+
+        const __m128 below = _mm_cmple_ps(f, zero);
+        lo = _mm_or_ps(_mm_and_ps(below, t), _mm_andnot_ps(below, lo));
+        hi = _mm_or_ps(_mm_andnot_ps(below, t), _mm_and_ps(below, hi));
+        const __m128 newton = _mm_sub_ps(t, _mm_div_ps(f, df));
+        const __m128 inside = _mm_and_ps(_mm_cmpgt_ps(df, zero), _mm_and_ps(_mm_cmpge_ps(newton, lo), _mm_cmple_ps(newton, hi)));
+        const __m128 next = _mm_or_ps(_mm_and_ps(inside, newton), _mm_andnot_ps(inside, _mm_mul_ps(half, _mm_add_ps(lo, hi))));
+        if (_mm_movemask_ps(_mm_cmpeq_ps(next, t)) == 0xF) break; // Every lane converged
+        t = next;
+    }
+    return t;
+}
+
+// All ones in the lanes whose bit is set.
+TARGET("sse2") __m128 lane_mask_sse2(unsigned bits){
+    const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), lane_bits), lane_bits));
+}
+
+TARGET("sse2") void bezier_distance_sse2(const float* control, const float* x, const float* y, float* distance, std::size_t n){
+    const DistanceSpans spans(control);
+    __m128 cx[4], cy[4];
+    for (int k = 0; k < 4; k++) { cx[k] = _mm_set1_ps(spans.q.x[k]); cy[k] = _mm_set1_ps(spans.q.y[k]); }
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 px = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_set1_ps(spans.origin_x));
+        const __m128 py = _mm_sub_ps(_mm_loadu_ps(y + i), _mm_set1_ps(spans.origin_y));
+        __m128 best = _mm_min_ps(distance_squared_sse2(cx, cy, px, py, zero), distance_squared_sse2(cx, cy, px, py, one));
+        for (int s = 0; s < DISTANCE_SPANS; s++)
+        {
+            const float lo = s / (float)DISTANCE_SPANS, hi = (s + 1) / (float)DISTANCE_SPANS;
+            __m128 b[6];
+            unsigned positive[6];
+            for (int j = 0; j < 6; j++)
+            {
+                b[j] = _mm_sub_ps(_mm_set1_ps(spans.g[s][j]), _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(spans.dx[s][j])), _mm_mul_ps(py, _mm_set1_ps(spans.dy[s][j]))));
+                positive[j] = (unsigned)_mm_movemask_ps(_mm_cmpgt_ps(b[j], zero));
+            }
+            unsigned ambiguous;
+            const unsigned rising = rising_lanes(positive, &ambiguous);
+            if (rising) {
+                const __m128 t = distance_root_sse2(cx, cy, px, py, _mm_set1_ps(lo), _mm_set1_ps(hi));
+                const __m128 mask = lane_mask_sse2(rising);
+                best = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(best, distance_squared_sse2(cx, cy, px, py, t))), _mm_andnot_ps(mask, best));
+            }
+            if (ambiguous) {
+                float lanes_b[6][4], lanes_x[4], lanes_y[4], lanes_best[4];
+                for (int j = 0; j < 6; j++) _mm_storeu_ps(lanes_b[j], b[j]);
+                _mm_storeu_ps(lanes_x, px);
+                _mm_storeu_ps(lanes_y, py);
+                _mm_storeu_ps(lanes_best, best);
+                for (int l = 0; l < 4; l++)
+                {
+                    if (!(ambiguous & (1u << l))) continue;
+                    const float lane_b[6] = {lanes_b[0][l], lanes_b[1][l], lanes_b[2][l], lanes_b[3][l], lanes_b[4][l], lanes_b[5][l]};
+                    lanes_best[l] = fminf(lanes_best[l], closest_in_span(spans.q, lanes_x[l], lanes_y[l], lane_b, lo, hi, 0));
+                }
+                best = _mm_loadu_ps(lanes_best);
+            }
+        }
+        _mm_storeu_ps(distance + i, _mm_sqrt_ps(best));
+    }
+    for (; i < n; i++) distance[i] = closest_distance(spans, x[i], y[i]);
+}
+
+//------------------------------------------------------------------------------------------------
+// AVX2 + FMA
+
+TARGET("avx2,fma") float dot_avx2(const float* a, const float* b, std::size_t n){
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i),     acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float result = _mm_cvtss_f32(sum);
+    for (; i < n; i++) result += a[i] * b[i];
+    return result;
+}
+
+TARGET("avx2,fma") void axpy_avx2(float alpha, const float* x, float* y, std::size_t n){
+    const __m256 a = _mm256_set1_ps(alpha);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    for (; i < n; i++) y[i] += alpha * x[i];
+}
+
+TARGET("avx2,fma") void add_avx2(const float* a, const float* b, float* out, std::size_t n){
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    for (; i < n; i++) out[i] = a[i] + b[i];
+}
+
+TARGET("avx2,fma") void sub_avx2(const float* a, const float* b, float* out, std::size_t n){
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    for (; i < n; i++) out[i] = a[i] - b[i];
+}
+
+TARGET("avx2,fma") void scale_avx2(const float* a, float alpha, float* out, std::size_t n){
+    const __m256 s = _mm256_set1_ps(alpha);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), s));
+    for (; i < n; i++) out[i] = a[i] * alpha;
+}
+
+// One register per row of the tile, the same kernel serves AVX-512 machines.
+TARGET("avx2,fma") void gemm_micro_avx2(std::size_t k, const float* a_panel, const float* b_panel, float* tile){
+    __m256 c0 = _mm256_setzero_ps(), c1 = _mm256_setzero_ps(), c2 = _mm256_setzero_ps(), c3 = _mm256_setzero_ps();
+    for (std::size_t p = 0; p < k; p++)
+    {
+        const __m256 b = _mm256_loadu_ps(b_panel + p * GEMM_NR);
+        const float* a = a_panel + p * GEMM_MR;
+        c0 = _mm256_fmadd_ps(_mm256_set1_ps(a[0]), b, c0);
+        c1 = _mm256_fmadd_ps(_mm256_set1_ps(a[1]), b, c1);
+        c2 = _mm256_fmadd_ps(_mm256_set1_ps(a[2]), b, c2);
+        c3 = _mm256_fmadd_ps(_mm256_set1_ps(a[3]), b, c3);
+    }
+    _mm256_storeu_ps(tile,      c0);
+    _mm256_storeu_ps(tile + 8,  c1);
+    _mm256_storeu_ps(tile + 16, c2);
+    _mm256_storeu_ps(tile + 24, c3);
+}
+
+// 8 lanes per register.
+TARGET("avx2,fma") void fit_batch_avx2(const float* x, const float* y, const int* count, std::size_t max_count, float* sums){
+    const int L = FIT_BATCH_LANES;
+    for (int l = 0; l < L; l += 8)
+    {
+        const __m256i n = _mm256_loadu_si256((const __m256i*)(count + l));
+        __m256 acc[FIT_BATCH_SUMS];
+        for (int k = 0; k < FIT_BATCH_SUMS; k++) acc[k] = _mm256_setzero_ps();
+
+        // Pass 1: total length and the last point of every lane.
+        __m256 total = _mm256_setzero_ps();
+        __m256 end_x = _mm256_loadu_ps(x + l), end_y = _mm256_loadu_ps(y + l);
+        for (std::size_t i = 1; i < max_count; i++)
+        {
+            const __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(n, _mm256_set1_epi32((int)i)));
+            const __m256 xi = _mm256_loadu_ps(x + i*L + l), yi = _mm256_loadu_ps(y + i*L + l);
+            const __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(x + (i-1)*L + l));
+            const __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(y + (i-1)*L + l));
+            const __m256 segment = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy)));
+            total = _mm256_add_ps(total, _mm256_and_ps(mask, segment));
+            end_x = _mm256_blendv_ps(end_x, xi, mask);
+            end_y = _mm256_blendv_ps(end_y, yi, mask);
+        }
+        const __m256 inv_total = _mm256_div_ps(_mm256_set1_ps(1), total);
+
+        // Pass 2: t of every point and the rows of the system.
+        const __m256 one = _mm256_set1_ps(1), three = _mm256_set1_ps(3);
+        __m256 length = _mm256_setzero_ps();
+        for (std::size_t i = 0; i < max_count; i++)
+        {
+            const __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(n, _mm256_set1_epi32((int)i)));
+            const __m256 xi = _mm256_loadu_ps(x + i*L + l), yi = _mm256_loadu_ps(y + i*L + l);
+            if (i > 0) {
+                const __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(x + (i-1)*L + l));
+                const __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(y + (i-1)*L + l));
+                length = _mm256_add_ps(length, _mm256_and_ps(mask, _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy)))));
+            }
+            const __m256 t = _mm256_mul_ps(length, inv_total), s = _mm256_sub_ps(one, t);
+            const __m256 a = _mm256_and_ps(mask, _mm256_mul_ps(three, _mm256_mul_ps(_mm256_mul_ps(s, s), t)));
+            const __m256 b = _mm256_and_ps(mask, _mm256_mul_ps(three, _mm256_mul_ps(_mm256_mul_ps(t, t), s)));
+            const __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+            const __m256 rx = _mm256_and_ps(mask, _mm256_fnmadd_ps(end_x, t3, xi));
+            const __m256 ry = _mm256_and_ps(mask, _mm256_fnmadd_ps(end_y, t3, yi));
+            acc[0] = _mm256_fmadd_ps(a, a, acc[0]);
+            acc[1] = _mm256_fmadd_ps(a, b, acc[1]);
+            acc[2] = _mm256_fmadd_ps(b, b, acc[2]);
+            acc[3] = _mm256_fmadd_ps(a, rx, acc[3]);
+            acc[4] = _mm256_fmadd_ps(b, rx, acc[4]);
+            acc[5] = _mm256_fmadd_ps(a, ry, acc[5]);
+            acc[6] = _mm256_fmadd_ps(b, ry, acc[6]);
+        }
+        for (int k = 0; k < FIT_BATCH_SUMS; k++) _mm256_storeu_ps(sums + k*L + l, acc[k]);
+    }
+}
+
+// Inclusive prefix sum of the 8 lanes: within each 128 bit half, then the low half's total is added to the high half.
+TARGET("avx2,fma") __m256 prefix_sum_avx2(__m256 v){
+    v = _mm256_add_ps(v, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(v), 4)));
+    v = _mm256_add_ps(v, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(v), 8)));
+    const __m256 low_total = _mm256_permute2f128_ps(v, v, 0x08); // [0, low half]
+    return _mm256_add_ps(v, _mm256_shuffle_ps(low_total, low_total, 0xFF));
+}
+
+template<bool Wide>
+TARGET("avx2,fma") void chord_parameterize_avx2(const float* x, const float* y, std::size_t n, float* t){
+    t[0] = 0;
+    __m256 carry = _mm256_setzero_ps();
+    __m256d wide_carry = _mm256_setzero_pd();
+    std::size_t i = 1;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(x + i - 1));
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(y + i - 1));
+        const __m256 sum = prefix_sum_avx2(_mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy))));
+        if (Wide) {
+            const __m256d low  = _mm256_add_pd(wide_carry, _mm256_cvtps_pd(_mm256_castps256_ps128(sum)));
+            const __m256d high = _mm256_add_pd(wide_carry, _mm256_cvtps_pd(_mm256_extractf128_ps(sum, 1)));
+            _mm256_storeu_ps(t + i, _mm256_set_m128(_mm256_cvtpd_ps(high), _mm256_cvtpd_ps(low)));
+            wide_carry = _mm256_permute4x64_pd(high, 0xFF);
+        }
+        else {
+            const __m256 cumulative = _mm256_add_ps(carry, sum);
+            _mm256_storeu_ps(t + i, cumulative);
+            carry = _mm256_permute_ps(_mm256_permute2f128_ps(cumulative, cumulative, 0x11), 0xFF);
+        }
+    }
+    typename std::conditional<Wide, double, float>::type length = Wide ? _mm256_cvtsd_f64(wide_carry) : _mm256_cvtss_f32(carry);
+    for (; i < n; i++)
+    {
+        const float dx = x[i] - x[i-1], dy = y[i] - y[i-1];
+        length += sqrtf(dx*dx + dy*dy);
+        t[i] = (float)length;
+    }
+    normalize_chord<scale_avx2>(t, n);
+}
+
+TARGET("avx2,fma") void bezier_newton_avx2(const float* control, const float* x, const float* y, float* t, std::size_t n){
+    const CubicPolynomial q(control);
+    __m256 cx[4], cy[4];
+    for (int k = 0; k < 4; k++) { cx[k] = _mm256_set1_ps(q.x[k]); cy[k] = _mm256_set1_ps(q.y[k]); }
+    const __m256 two = _mm256_set1_ps(2), three = _mm256_set1_ps(3), six = _mm256_set1_ps(6);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 ti = _mm256_loadu_ps(t + i);
+        const __m256 dx = _mm256_sub_ps(_mm256_fmadd_ps(ti, _mm256_fmadd_ps(ti, _mm256_fmadd_ps(ti, cx[3], cx[2]), cx[1]), cx[0]), _mm256_loadu_ps(x + i));
+        const __m256 dy = _mm256_sub_ps(_mm256_fmadd_ps(ti, _mm256_fmadd_ps(ti, _mm256_fmadd_ps(ti, cy[3], cy[2]), cy[1]), cy[0]), _mm256_loadu_ps(y + i));
+        const __m256 d1x = _mm256_fmadd_ps(ti, _mm256_fmadd_ps(_mm256_mul_ps(three, cx[3]), ti, _mm256_mul_ps(two, cx[2])), cx[1]);
+        const __m256 d1y = _mm256_fmadd_ps(ti, _mm256_fmadd_ps(_mm256_mul_ps(three, cy[3]), ti, _mm256_mul_ps(two, cy[2])), cy[1]);
+        const __m256 d2x = _mm256_fmadd_ps(_mm256_mul_ps(six, cx[3]), ti, _mm256_mul_ps(two, cx[2]));
+        const __m256 d2y = _mm256_fmadd_ps(_mm256_mul_ps(six, cy[3]), ti, _mm256_mul_ps(two, cy[2]));
+        const __m256 numerator = _mm256_fmadd_ps(dx, d1x, _mm256_mul_ps(dy, d1y));
+        const __m256 denominator = _mm256_fmadd_ps(d1x, d1x, _mm256_fmadd_ps(d1y, d1y, _mm256_fmadd_ps(dx, d2x, _mm256_mul_ps(dy, d2y))));
+        const __m256 step = _mm256_and_ps(_mm256_cmp_ps(denominator, zero, _CMP_GT_OQ), _mm256_div_ps(numerator, denominator));
+        _mm256_storeu_ps(t + i, _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(ti, step), zero), one));
+    }
+    for (; i < n; i++) t[i] = newton_step(q, x[i], y[i], t[i]);
+}
+
+TARGET("avx2,fma") __m256 distance_squared_avx2(const __m256* cx, const __m256* cy, __m256 px, __m256 py, __m256 t){
+    const __m256 dx = _mm256_fmsub_ps(t, _mm256_fmadd_ps(t, _mm256_fmadd_ps(t, cx[3], cx[2]), cx[1]), px);
+    const __m256 dy = _mm256_fmsub_ps(t, _mm256_fmadd_ps(t, _mm256_fmadd_ps(t, cy[3], cy[2]), cy[1]), py);
+    return _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+}
+
+// distance_root on 8 lanes, relative to P0 so c0 is 0.
+TARGET("avx2,fma") __m256 distance_root_avx2(const __m256* cx, const __m256* cy, __m256 px, __m256 py, __m256 lo, __m256 hi){
+    const __m256 two = _mm256_set1_ps(2), three = _mm256_set1_ps(3), six = _mm256_set1_ps(6), half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 t = _mm256_mul_ps(half, _mm256_add_ps(lo, hi));
+    for (int k = 0; k < DISTANCE_NEWTON_STEPS; k++)
+    {
+        const __m256 dx = _mm256_fmsub_ps(t, _mm256_fmadd_ps(t, _mm256_fmadd_ps(t, cx[3], cx[2]), cx[1]), px);
+        const __m256 dy = _mm256_fmsub_ps(t, _mm256_fmadd_ps(t, _mm256_fmadd_ps(t, cy[3], cy[2]), cy[1]), py);
+        const __m256 d1x = _mm256_fmadd_ps(t, _mm256_fmadd_ps(_mm256_mul_ps(three, cx[3]), t, _mm256_mul_ps(two, cx[2])), cx[1]);
+        const __m256 d1y = _mm256_fmadd_ps(t, _mm256_fmadd_ps(_mm256_mul_ps(three, cy[3]), t, _mm256_mul_ps(two, cy[2])), cy[1]);
+        const __m256 d2x = _mm256_fmadd_ps(_mm256_mul_ps(six, cx[3]), t, _mm256_mul_ps(two, cx[2]));
+        const __m256 d2y = _mm256_fmadd_ps(_mm256_mul_ps(six, cy[3]), t, _mm256_mul_ps(two, cy[2]));
+        const __m256 f = _mm256_fmadd_ps(dx, d1x, _mm256_mul_ps(dy, d1y));
+        const __m256 df = _mm256_fmadd_ps(d1x, d1x, _mm256_fmadd_ps(d1y, d1y, _mm256_fmadd_ps(dx, d2x, _mm256_mul_ps(dy, d2y))));
+
+        const __m256 below = _mm256_cmp_ps(f, zero, _CMP_LE_OQ);
+        lo = _mm256_blendv_ps(lo, t, below);
+        hi = _mm256_blendv_ps(t, hi, below);
+        const __m256 newton = _mm256_sub_ps(t, _mm256_div_ps(f, df));
+        const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(df, zero, _CMP_GT_OQ),
+            _mm256_and_ps(_mm256_cmp_ps(newton, lo, _CMP_GE_OQ), _mm256_cmp_ps(newton, hi, _CMP_LE_OQ)));
+        const __m256 next = _mm256_blendv_ps(_mm256_mul_ps(half, _mm256_add_ps(lo, hi)), newton, inside);
+        if (_mm256_movemask_ps(_mm256_cmp_ps(next, t, _CMP_EQ_OQ)) == 0xFF) break; // Every lane converged
+        t = next;
+    }
+    return t;
+}
+
+// All ones in the lanes whose bit is set.
+TARGET("avx2,fma") __m256 lane_mask_avx2(unsigned bits){
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), lane_bits), lane_bits));
+}
+
+TARGET("avx2,fma") void bezier_distance_avx2(const float* control, const float* x, const float* y, float* distance, std::size_t n){
+    const DistanceSpans spans(control);
+    __m256 cx[4], cy[4];
+    for (int k = 0; k < 4; k++) { cx[k] = _mm256_set1_ps(spans.q.x[k]); cy[k] = _mm256_set1_ps(spans.q.y[k]); }
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 px = _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_set1_ps(spans.origin_x));
+        const __m256 py = _mm256_sub_ps(_mm256_loadu_ps(y + i), _mm256_set1_ps(spans.origin_y));
+        __m256 best = _mm256_min_ps(distance_squared_avx2(cx, cy, px, py, zero), distance_squared_avx2(cx, cy, px, py, one));
+        for (int s = 0; s < DISTANCE_SPANS; s++)
+        {
+            const float lo = s / (float)DISTANCE_SPANS, hi = (s + 1) / (float)DISTANCE_SPANS;
+            __m256 b[6];
+            unsigned positive[6];
+            for (int j = 0; j < 6; j++)
+            {
+                b[j] = _mm256_fnmadd_ps(py, _mm256_set1_ps(spans.dy[s][j]), _mm256_fnmadd_ps(px, _mm256_set1_ps(spans.dx[s][j]), _mm256_set1_ps(spans.g[s][j])));
+                positive[j] = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(b[j], zero, _CMP_GT_OQ));
+            }
+            unsigned ambiguous;
+            const unsigned rising = rising_lanes(positive, &ambiguous);
+            if (rising) {
+                const __m256 t = distance_root_avx2(cx, cy, px, py, _mm256_set1_ps(lo), _mm256_set1_ps(hi));
+                best = _mm256_blendv_ps(best, _mm256_min_ps(best, distance_squared_avx2(cx, cy, px, py, t)), lane_mask_avx2(rising));
+            }
+            if (ambiguous) {
+                float lanes_b[6][8], lanes_x[8], lanes_y[8], lanes_best[8];
+                for (int j = 0; j < 6; j++) _mm256_storeu_ps(lanes_b[j], b[j]);
+                _mm256_storeu_ps(lanes_x, px);
+                _mm256_storeu_ps(lanes_y, py);
+                _mm256_storeu_ps(lanes_best, best);
+                for (int l = 0; l < 8; l++)
+                {
+                    if (!(ambiguous & (1u << l))) continue;
+                    const float lane_b[6] = {lanes_b[0][l], lanes_b[1][l], lanes_b[2][l], lanes_b[3][l], lanes_b[4][l], lanes_b[5][l]};
+                    lanes_best[l] = fminf(lanes_best[l], closest_in_span(spans.q, lanes_x[l], lanes_y[l], lane_b, lo, hi, 0));
+                }
+                best = _mm256_loadu_ps(lanes_best);
+            }
+        }
+        _mm256_storeu_ps(distance + i, _mm256_sqrt_ps(best));
+    }
+    for (; i < n; i++) distance[i] = closest_distance(spans, x[i], y[i]);
+}
+
+//------------------------------------------------------------------------------------------------
+// AVX-512F, tails are handled with masked loads instead of a scalar loop.
+
+TARGET("avx512f") __mmask16 tail_mask(std::size_t remaining){
+    return remaining >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << remaining) - 1);
+}
+
+TARGET("avx512f") float dot_avx512(const float* a, const float* b, std::size_t n){
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i),      _mm512_loadu_ps(b + i),      acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc0);
+    }
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float result = 0;
+    for (int lane = 0; lane < 16; lane++) result += lanes[lane];
+    return result;
+}
+
+TARGET("avx512f") void axpy_avx512(float alpha, const float* x, float* y, std::size_t n){
+    const __m512 a = _mm512_set1_ps(alpha);
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        const __m512 result = _mm512_fmadd_ps(a, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i));
+        _mm512_mask_storeu_ps(y + i, mask, result);
+    }
+}
+
+TARGET("avx512f") void add_avx512(const float* a, const float* b, float* out, std::size_t n){
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i)));
+    }
+}
+
+TARGET("avx512f") void sub_avx512(const float* a, const float* b, float* out, std::size_t n){
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i)));
+    }
+}
+
+TARGET("avx512f") void scale_avx512(const float* a, float alpha, float* out, std::size_t n){
+    const __m512 s = _mm512_set1_ps(alpha);
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, a + i), s));
+    }
+}
+
+// Inclusive prefix sum of the 16 lanes, shifting in zeros with alignr.
+// Full masks on the maskz forms throughout, the unmasked ones trip GCC's uninitialized warnings.
+TARGET("avx512f") __m512 prefix_sum_avx512(__m512 v){
+    const __mmask16 all = 0xFFFF;
+    const __m512i zero = _mm512_setzero_si512();
+    v = _mm512_add_ps(v, _mm512_castsi512_ps(_mm512_maskz_alignr_epi32(all, _mm512_castps_si512(v), zero, 15)));
+    v = _mm512_add_ps(v, _mm512_castsi512_ps(_mm512_maskz_alignr_epi32(all, _mm512_castps_si512(v), zero, 14)));
+    v = _mm512_add_ps(v, _mm512_castsi512_ps(_mm512_maskz_alignr_epi32(all, _mm512_castps_si512(v), zero, 12)));
+    v = _mm512_add_ps(v, _mm512_castsi512_ps(_mm512_maskz_alignr_epi32(all, _mm512_castps_si512(v), zero, 8)));
+    return v;
+}
+
+// The tail runs masked like the other AVX-512 kernels.
+template<bool Wide>
+TARGET("avx512f") void chord_parameterize_avx512(const float* x, const float* y, std::size_t n, float* t){
+    t[0] = 0;
+    const __m512i last = _mm512_set1_epi32(15);
+    __m512 carry = _mm512_setzero_ps();
+    __m512d wide_carry = _mm512_setzero_pd();
+    for (std::size_t i = 1; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        const __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, x + i - 1));
+        const __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y + i), _mm512_maskz_loadu_ps(mask, y + i - 1));
+        const __m512 sum = prefix_sum_avx512(_mm512_maskz_sqrt_ps(mask, _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy))));
+        if (Wide) {
+            const __m256 sum_low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(sum), 0));
+            const __m256 sum_high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(sum), 1));
+            const __m512d low  = _mm512_add_pd(wide_carry, _mm512_maskz_cvtps_pd(0xFF, sum_low));
+            const __m512d high = _mm512_add_pd(wide_carry, _mm512_maskz_cvtps_pd(0xFF, sum_high));
+            const __m512d cumulative = _mm512_maskz_insertf64x4(0xFF, _mm512_castps_pd(_mm512_castps256_ps512(_mm512_maskz_cvtpd_ps(0xFF, low))),
+                _mm256_castps_pd(_mm512_maskz_cvtpd_ps(0xFF, high)), 1);
+            _mm512_mask_storeu_ps(t + i, mask, _mm512_castpd_ps(cumulative));
+            wide_carry = _mm512_maskz_permutexvar_pd(0xFF, _mm512_set1_epi64(7), high);
+        }
+        else {
+            const __m512 cumulative = _mm512_add_ps(carry, sum);
+            _mm512_mask_storeu_ps(t + i, mask, cumulative);
+            carry = _mm512_maskz_permutexvar_ps(0xFFFF, last, cumulative);
+        }
+    }
+    normalize_chord<scale_avx512>(t, n);
+}
+
+// All 16 lanes in one register, masks are native.
+TARGET("avx512f") void fit_batch_avx512(const float* x, const float* y, const int* count, std::size_t max_count, float* sums){
+    const int L = FIT_BATCH_LANES;
+    const __m512i n = _mm512_loadu_si512(count);
+    __m512 acc[FIT_BATCH_SUMS];
+    for (int k = 0; k < FIT_BATCH_SUMS; k++) acc[k] = _mm512_setzero_ps();
+
+    // Pass 1: total length and the last point of every lane.
+    __m512 total = _mm512_setzero_ps();
+    __m512 end_x = _mm512_loadu_ps(x), end_y = _mm512_loadu_ps(y);
+    for (std::size_t i = 1; i < max_count; i++)
+    {
+        const __mmask16 mask = _mm512_cmpgt_epi32_mask(n, _mm512_set1_epi32((int)i));
+        const __m512 xi = _mm512_loadu_ps(x + i*L), yi = _mm512_loadu_ps(y + i*L);
+        const __m512 dx = _mm512_sub_ps(xi, _mm512_loadu_ps(x + (i-1)*L));
+        const __m512 dy = _mm512_sub_ps(yi, _mm512_loadu_ps(y + (i-1)*L));
+        total = _mm512_add_ps(total, _mm512_maskz_sqrt_ps(mask, _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy))));
+        end_x = _mm512_mask_mov_ps(end_x, mask, xi);
+        end_y = _mm512_mask_mov_ps(end_y, mask, yi);
+    }
+    const __m512 inv_total = _mm512_div_ps(_mm512_set1_ps(1), total);
+
+    // Pass 2: t of every point and the rows of the system.
+    const __m512 one = _mm512_set1_ps(1), three = _mm512_set1_ps(3);
+    __m512 length = _mm512_setzero_ps();
+    for (std::size_t i = 0; i < max_count; i++)
+    {
+        const __mmask16 mask = _mm512_cmpgt_epi32_mask(n, _mm512_set1_epi32((int)i));
+        const __m512 xi = _mm512_loadu_ps(x + i*L), yi = _mm512_loadu_ps(y + i*L);
+        if (i > 0) {
+            const __m512 dx = _mm512_sub_ps(xi, _mm512_loadu_ps(x + (i-1)*L));
+            const __m512 dy = _mm512_sub_ps(yi, _mm512_loadu_ps(y + (i-1)*L));
+            length = _mm512_add_ps(length, _mm512_maskz_sqrt_ps(mask, _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy))));
+        }
+        const __m512 t = _mm512_mul_ps(length, inv_total), s = _mm512_sub_ps(one, t);
+        const __m512 a = _mm512_maskz_mul_ps(mask, three, _mm512_mul_ps(_mm512_mul_ps(s, s), t));
+        const __m512 b = _mm512_maskz_mul_ps(mask, three, _mm512_mul_ps(_mm512_mul_ps(t, t), s));
+        const __m512 t3 = _mm512_mul_ps(_mm512_mul_ps(t, t), t);
+        const __m512 rx = _mm512_maskz_fnmadd_ps(mask, end_x, t3, xi);
+        const __m512 ry = _mm512_maskz_fnmadd_ps(mask, end_y, t3, yi);
+        acc[0] = _mm512_fmadd_ps(a, a, acc[0]);
+        acc[1] = _mm512_fmadd_ps(a, b, acc[1]);
+        acc[2] = _mm512_fmadd_ps(b, b, acc[2]);
+        acc[3] = _mm512_fmadd_ps(a, rx, acc[3]);
+        acc[4] = _mm512_fmadd_ps(b, rx, acc[4]);
+        acc[5] = _mm512_fmadd_ps(a, ry, acc[5]);
+        acc[6] = _mm512_fmadd_ps(b, ry, acc[6]);
+    }
+    for (int k = 0; k < FIT_BATCH_SUMS; k++) _mm512_storeu_ps(sums + k*L, acc[k]);
+}
+
+TARGET("avx512f") void bezier_newton_avx512(const float* control, const float* x, const float* y, float* t, std::size_t n){
+    const CubicPolynomial q(control);
+    __m512 cx[4], cy[4];
+    for (int k = 0; k < 4; k++) { cx[k] = _mm512_set1_ps(q.x[k]); cy[k] = _mm512_set1_ps(q.y[k]); }
+    const __m512 two = _mm512_set1_ps(2), three = _mm512_set1_ps(3), six = _mm512_set1_ps(6);
+    const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1);
+
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        const __m512 ti = _mm512_maskz_loadu_ps(mask, t + i);
+        const __m512 dx = _mm512_sub_ps(_mm512_fmadd_ps(ti, _mm512_fmadd_ps(ti, _mm512_fmadd_ps(ti, cx[3], cx[2]), cx[1]), cx[0]), _mm512_maskz_loadu_ps(mask, x + i));
+        const __m512 dy = _mm512_sub_ps(_mm512_fmadd_ps(ti, _mm512_fmadd_ps(ti, _mm512_fmadd_ps(ti, cy[3], cy[2]), cy[1]), cy[0]), _mm512_maskz_loadu_ps(mask, y + i));
+        const __m512 d1x = _mm512_fmadd_ps(ti, _mm512_fmadd_ps(_mm512_mul_ps(three, cx[3]), ti, _mm512_mul_ps(two, cx[2])), cx[1]);
+        const __m512 d1y = _mm512_fmadd_ps(ti, _mm512_fmadd_ps(_mm512_mul_ps(three, cy[3]), ti, _mm512_mul_ps(two, cy[2])), cy[1]);
+        const __m512 d2x = _mm512_fmadd_ps(_mm512_mul_ps(six, cx[3]), ti, _mm512_mul_ps(two, cx[2]));
+        const __m512 d2y = _mm512_fmadd_ps(_mm512_mul_ps(six, cy[3]), ti, _mm512_mul_ps(two, cy[2]));
+        const __m512 numerator = _mm512_fmadd_ps(dx, d1x, _mm512_mul_ps(dy, d1y));
+        const __m512 denominator = _mm512_fmadd_ps(d1x, d1x, _mm512_fmadd_ps(d1y, d1y, _mm512_fmadd_ps(dx, d2x, _mm512_mul_ps(dy, d2y))));
+        const __m512 step = _mm512_maskz_div_ps(_mm512_cmp_ps_mask(denominator, zero, _CMP_GT_OQ), numerator, denominator);
+        _mm512_mask_storeu_ps(t + i, mask, _mm512_maskz_min_ps(mask, _mm512_maskz_max_ps(mask, _mm512_sub_ps(ti, step), zero), one));
+    }
+}
+
+TARGET("avx512f") __m512 distance_squared_avx512(const __m512* cx, const __m512* cy, __m512 px, __m512 py, __m512 t){
+    const __m512 dx = _mm512_fmsub_ps(t, _mm512_fmadd_ps(t, _mm512_fmadd_ps(t, cx[3], cx[2]), cx[1]), px);
+    const __m512 dy = _mm512_fmsub_ps(t, _mm512_fmadd_ps(t, _mm512_fmadd_ps(t, cy[3], cy[2]), cy[1]), py);
+    return _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+}
+
+// distance_root on 16 lanes, relative to P0 so c0 is 0.
+TARGET("avx512f") __m512 distance_root_avx512(const __m512* cx, const __m512* cy, __m512 px, __m512 py, __m512 lo, __m512 hi){
+    const __m512 two = _mm512_set1_ps(2), three = _mm512_set1_ps(3), six = _mm512_set1_ps(6), half = _mm512_set1_ps(0.5f);
+    const __m512 zero = _mm512_setzero_ps();
+    __m512 t = _mm512_mul_ps(half, _mm512_add_ps(lo, hi));
+    for (int k = 0; k < DISTANCE_NEWTON_STEPS; k++)
+    {
+        const __m512 dx = _mm512_fmsub_ps(t, _mm512_fmadd_ps(t, _mm512_fmadd_ps(t, cx[3], cx[2]), cx[1]), px);
+        const __m512 dy = _mm512_fmsub_ps(t, _mm512_fmadd_ps(t, _mm512_fmadd_ps(t, cy[3], cy[2]), cy[1]), py);
+        const __m512 d1x = _mm512_fmadd_ps(t, _mm512_fmadd_ps(_mm512_mul_ps(three, cx[3]), t, _mm512_mul_ps(two, cx[2])), cx[1]);
+        const __m512 d1y = _mm512_fmadd_ps(t, _mm512_fmadd_ps(_mm512_mul_ps(three, cy[3]), t, _mm512_mul_ps(two, cy[2])), cy[1]);
+        const __m512 d2x = _mm512_fmadd_ps(_mm512_mul_ps(six, cx[3]), t, _mm512_mul_ps(two, cx[2]));
+        const __m512 d2y = _mm512_fmadd_ps(_mm512_mul_ps(six, cy[3]), t, _mm512_mul_ps(two, cy[2]));
+        const __m512 f = _mm512_fmadd_ps(dx, d1x, _mm512_mul_ps(dy, d1y));
+        const __m512 df = _mm512_fmadd_ps(d1x, d1x, _mm512_fmadd_ps(d1y, d1y, _mm512_fmadd_ps(dx, d2x, _mm512_mul_ps(dy, d2y))));
+
+        const __mmask16 below = _mm512_cmp_ps_mask(f, zero, _CMP_LE_OQ);
+        lo = _mm512_mask_blend_ps(below, lo, t);
+        hi = _mm512_mask_blend_ps(below, t, hi);
+        const __m512 newton = _mm512_sub_ps(t, _mm512_div_ps(f, df));
+        const __mmask16 inside = _mm512_cmp_ps_mask(df, zero, _CMP_GT_OQ) & _mm512_cmp_ps_mask(newton, lo, _CMP_GE_OQ) & _mm512_cmp_ps_mask(newton, hi, _CMP_LE_OQ);
+        const __m512 next = _mm512_mask_blend_ps(inside, _mm512_mul_ps(half, _mm512_add_ps(lo, hi)), newton);
+        if (_mm512_cmp_ps_mask(next, t, _CMP_EQ_OQ) == 0xFFFF) break; // Every lane converged
+        t = next;
+    }
+    return t;
+}
+
+TARGET("avx512f") void bezier_distance_avx512(const float* control, const float* x, const float* y, float* distance, std::size_t n){
+    const DistanceSpans spans(control);
+    __m512 cx[4], cy[4];
+    for (int k = 0; k < 4; k++) { cx[k] = _mm512_set1_ps(spans.q.x[k]); cy[k] = _mm512_set1_ps(spans.q.y[k]); }
+    const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1);
+
+    for (std::size_t i = 0; i < n; i += 16)
+    {
+        const __mmask16 mask = tail_mask(n - i);
+        const __m512 px = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_set1_ps(spans.origin_x));
+        const __m512 py = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, y + i), _mm512_set1_ps(spans.origin_y));
+        __m512 best = _mm512_maskz_min_ps(0xFFFF, distance_squared_avx512(cx, cy, px, py, zero), distance_squared_avx512(cx, cy, px, py, one));
+        for (int s = 0; s < DISTANCE_SPANS; s++)
+        {
+            const float lo = s / (float)DISTANCE_SPANS, hi = (s + 1) / (float)DISTANCE_SPANS;
+            __m512 b[6];
+            unsigned positive[6];
+            for (int j = 0; j < 6; j++)
+            {
+                b[j] = _mm512_fnmadd_ps(py, _mm512_set1_ps(spans.dy[s][j]), _mm512_fnmadd_ps(px, _mm512_set1_ps(spans.dx[s][j]), _mm512_set1_ps(spans.g[s][j])));
+                positive[j] = _mm512_cmp_ps_mask(b[j], zero, _CMP_GT_OQ);
+            }
+            unsigned ambiguous;
+            const __mmask16 rising = (__mmask16)(rising_lanes(positive, &ambiguous) & mask);
+            ambiguous &= mask;
+            if (rising) {
+                const __m512 t = distance_root_avx512(cx, cy, px, py, _mm512_set1_ps(lo), _mm512_set1_ps(hi));
+                best = _mm512_mask_min_ps(best, rising, best, distance_squared_avx512(cx, cy, px, py, t));
+            }
+            if (ambiguous) {
+                float lanes_b[6][16], lanes_x[16], lanes_y[16], lanes_best[16];
+                for (int j = 0; j < 6; j++) _mm512_storeu_ps(lanes_b[j], b[j]);
+                _mm512_storeu_ps(lanes_x, px);
+                _mm512_storeu_ps(lanes_y, py);
+                _mm512_storeu_ps(lanes_best, best);
+                for (int l = 0; l < 16; l++)
+                {
+                    if (!(ambiguous & (1u << l))) continue;
+                    const float lane_b[6] = {lanes_b[0][l], lanes_b[1][l], lanes_b[2][l], lanes_b[3][l], lanes_b[4][l], lanes_b[5][l]};
+                    lanes_best[l] = fminf(lanes_best[l], closest_in_span(spans.q, lanes_x[l], lanes_y[l], lane_b, lo, hi, 0));
+                }
+                best = _mm512_loadu_ps(lanes_best);
+            }
+        }
+        _mm512_mask_storeu_ps(distance + i, mask, _mm512_maskz_sqrt_ps(mask, best));
+    }
+}
+#endif // SIMD_X86
+
+//------------------------------------------------------------------------------------------------
+
+#define KERNEL_TABLE(ISA, suffix, gemm_micro) { \
+    ISA, \
+    dot_##suffix, axpy_##suffix, add_##suffix, sub_##suffix, scale_##suffix, \
+    reflector_update_impl<dot_##suffix, axpy_##suffix>, \
+    matvec_impl<dot_##suffix>, \
+    gemm_micro, \
+    fit_batch_##suffix, \
+    chord_parameterize_##suffix<false>, chord_parameterize_##suffix<true>, \
+    bezier_newton_##suffix, \
+    bezier_distance_##suffix \
+}
+
+const SimdKernels scalar_kernels = KERNEL_TABLE(SimdIsa::Scalar, scalar, gemm_micro_scalar);
+#ifdef SIMD_X86
+const SimdKernels sse2_kernels   = KERNEL_TABLE(SimdIsa::SSE2, sse2, gemm_micro_sse2);
+const SimdKernels avx2_kernels   = KERNEL_TABLE(SimdIsa::AVX2, avx2, gemm_micro_avx2);
+const SimdKernels avx512_kernels = KERNEL_TABLE(SimdIsa::AVX512, avx512, gemm_micro_avx2);
+#endif
+
+#undef KERNEL_TABLE
+
+bool SimdIsaSupported(SimdIsa isa){
+    switch (isa)
+    {
+    case SimdIsa::Scalar: return true;
+#ifdef SIMD_X86
+    case SimdIsa::SSE2:   return __builtin_cpu_supports("sse2");
+    case SimdIsa::AVX2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    // The AVX-512 table borrows the AVX2 + FMA gemm micro kernel.
+    case SimdIsa::AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    default: return false;
+    }
+}
+
+const SimdKernels& SimdKernelsFor(SimdIsa isa){
+    if (!SimdIsaSupported(isa)) return scalar_kernels;
+    switch (isa)
+    {
+#ifdef SIMD_X86
+    case SimdIsa::SSE2:   return sse2_kernels;
+    case SimdIsa::AVX2:   return avx2_kernels;
+    case SimdIsa::AVX512: return avx512_kernels;
+#endif
+    default: return scalar_kernels;
+    }
+}
+
+const SimdKernels& Simd(){
+    static const SimdKernels& best = []() -> const SimdKernels& {
+        const SimdIsa widest_first[] = {SimdIsa::AVX512, SimdIsa::AVX2, SimdIsa::SSE2};
+        for (SimdIsa isa : widest_first)
+        {
+            if (SimdIsaSupported(isa)) return SimdKernelsFor(isa);
+        }
+        return scalar_kernels;
+    }();
+    return best;
+}
+
+const char* SimdIsaName(SimdIsa isa){
+    switch (isa)
+    {
+    case SimdIsa::SSE2:   return "SSE2";
+    case SimdIsa::AVX2:   return "AVX2";
+    case SimdIsa::AVX512: return "AVX-512";
+    default:              return "Scalar";
+    }
+}
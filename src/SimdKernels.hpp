@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+
+enum class SimdIsa
+{
+    Scalar,
+    SSE2,
+    AVX2,   // With FMA
+    AVX512, // AVX-512F
+};
+
+// Float kernels for the dense Matrix/Vector arithmetic of the fitter.
+// One table exists per instruction set, the best one the CPU supports is picked once at startup.
+struct SimdKernels
+{
+    SimdIsa isa;
+
+    // sum(a[i] * b[i])
+    float (*dot)(const float* a, const float* b, std::size_t n);
+
+    // y += alpha * x
+    void (*axpy)(float alpha, const float* x, float* y, std::size_t n);
+
+    // out = a + b, out = a - b, out = a * alpha. out may alias a or b.
+    void (*add)(const float* a, const float* b, float* out, std::size_t n);
+    void (*sub)(const float* a, const float* b, float* out, std::size_t n);
+    void (*scale)(const float* a, float alpha, float* out, std::size_t n);
+
+    // A = (I - 2*w*w^T) * A for cols contiguous columns of length n, column_stride floats apart.
+    void (*reflector_update)(const float* w, float* A, std::size_t n, std::size_t cols, std::size_t column_stride);
+
+    // y = A * x, A is row major m*n.
+    void (*matvec)(const float* A, const float* x, float* y, std::size_t m, std::size_t n);
+
+    // tile = a_panel * b_panel, the register resident GEMM_MR x GEMM_NR block of a matrix product.
+    // a_panel holds k columns of GEMM_MR floats, b_panel k rows of GEMM_NR floats, tile is row major.
+    void (*gemm_micro)(std::size_t k, const float* a_panel, const float* b_panel, float* tile);
+
+    // Normal equations of the chord length cubic fit for FIT_BATCH_LANES strokes at once, one stroke per lane.
+    // Point i of lane l is at x/y[i*FIT_BATCH_LANES + l], translated so the first point of every lane is the origin.
+    // Lane l has count[l] points, anything past them is masked out. sums receives 7 rows of FIT_BATCH_LANES:
+    // A^T*A as s00 s01 s11, then A^T*bx and A^T*by as 2 rows each.
+    void (*fit_batch)(const float* x, const float* y, const int* count, std::size_t max_count, float* sums);
+
+    // Chord length parameter of n >= 2 points: t[i] = length of the polyline up to point i / its total length.
+    // Segment lengths and the prefix sum are fused into a single sweep, then t is normalized in place.
+    void (*chord_parameterize)(const float* x, const float* y, std::size_t n, float* t);
+
+    // Same, the running sum is carried in double so it does not drift on very long strokes.
+    void (*chord_parameterize_wide)(const float* x, const float* y, std::size_t n, float* t);
+
+    // One Newton step of every t[i] towards the point of the cubic closest to (x[i], y[i]), clamped to [0, 1].
+    // t -= (Q(t) - p).Q'(t) / (Q'(t).Q'(t) + (Q(t) - p).Q''(t)), control holds P0..P3 as x, y pairs.
+    void (*bezier_newton)(const float* control, const float* x, const float* y, float* t, std::size_t n);
+
+    // Distance of every (x[i], y[i]) from the closest point of the cubic, rather than from the point at some t.
+    // The closest point is a root of the quintic (Q(t) - p).Q'(t), isolated per span of t in Bernstein form
+    // and polished with bracketed Newton steps, control holds P0..P3 as x, y pairs.
+    void (*bezier_distance)(const float* control, const float* x, const float* y, float* distance, std::size_t n);
+};
+
+static const int GEMM_MR = 4;
+static const int GEMM_NR = 8;
+
+// Group width of fit_batch, the same for every ISA so the packed layout does not depend on the CPU.
+static const int FIT_BATCH_LANES = 16;
+static const int FIT_BATCH_SUMS = 7;
+
+// Kernels for the widest instruction set this CPU supports.
+const SimdKernels& Simd();
+
+bool SimdIsaSupported(SimdIsa isa);
+
+// Kernels for a specific instruction set, used to compare ISAs against each other.
+// isa must be supported by this CPU.
+const SimdKernels& SimdKernelsFor(SimdIsa isa);
+
+const char* SimdIsaName(SimdIsa isa);
@@ -0,0 +1,65 @@
+#include "TaskPool.hpp"
+
+#include <algorithm>
+
+TaskPool::TaskPool(int threads){
+    workers.reserve(threads);
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back([this](){
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                changed.wait(lock, [this](){ return stopping || !tasks.empty(); });
+                if (tasks.empty()) return; // Stopping, and nothing left to run
+                RunFront(lock);
+            }
+        });
+    }
+}
+
+TaskPool::~TaskPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+void TaskPool::Submit(TaskGroup& group, std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        group.pending++;
+        tasks.push_back({&group, std::move(task)});
+    }
+    changed.notify_one();
+}
+
+void TaskPool::Wait(TaskGroup& group){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (group.pending > 0)
+    {
+        // Any queued task helps, the ones of this group may be waiting behind others.
+        if (!tasks.empty()) RunFront(lock);
+        else changed.wait(lock);
+    }
+}
+
+void TaskPool::RunFront(std::unique_lock<std::mutex>& lock){
+    Task task = std::move(tasks.front());
+    tasks.pop_front();
+
+    lock.unlock();
+    task.run();
+    lock.lock();
+
+    task.group->pending--;
+    // Waiters check their own group, workers may have new tasks to pick up.
+    changed.notify_all();
+}
+
+TaskPool& TaskPool::Shared(){
+    static TaskPool pool(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+    return pool;
+}
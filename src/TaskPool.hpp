@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks submitted together, so a caller can wait for its own tasks only.
+struct TaskGroup
+{
+    std::size_t pending = 0; // Submitted and not finished, guarded by the pool's mutex.
+};
+
+// Fixed set of worker threads running submitted tasks, tasks may submit more tasks into their group.
+// Waiting threads run queued tasks themselves instead of blocking, so nesting never deadlocks.
+class TaskPool
+{
+public:
+    // threads workers besides the threads that Wait.
+    explicit TaskPool(int threads);
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+    ~TaskPool();
+
+    void Submit(TaskGroup& group, std::function<void()> task);
+
+    // Returns once every task of group, including the ones its tasks submitted, has finished.
+    void Wait(TaskGroup& group);
+
+    int Threads() const { return (int)workers.size(); }
+
+    // One worker per core but the calling one, started on first use.
+    static TaskPool& Shared();
+
+private:
+    struct Task
+    {
+        TaskGroup* group;
+        std::function<void()> run;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable changed; // A task was queued or finished, or the pool is stopping.
+    bool stopping = false;
+
+    // Pops and runs the front task, lock is held on entry and on return.
+    void RunFront(std::unique_lock<std::mutex>& lock);
+};
@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 #include "CurveFitting.hpp"
+#include "OneEuroFilter.hpp"
 
 #include "loadShader.hpp"
 #include "Shaders.h"
@@ -96,54 +99,122 @@ void CursorWorldPosition(float inX, float inY, float* x, float* y){
 int vertexCount = 0;
 int maxVertices = 255;
 float verts[255 * 2] = {0};
+double vertexTimes[255] = {0}; // glfwGetTime of every vertex, for the corner finder
 OGLID pVBO, pVAO;
 
 bool isValid = false;
 OGLID bVBO, bVAO;
+int bezierCount = 0;    // Patches in bVBO
+int bezierCapacity = 1; // Patches bVBO has room for
 
-void RenderBezier(){
-    if (vertexCount < 4) return;
+// Largest distance of a stroke point from its piece, in world units (pixelsPerUnit is 100).
+float fitTolerance = 0.05f;
 
-    std::vector<Point> points; points.reserve(vertexCount);
-    for (size_t i = 0; i < (size_t)vertexCount; i++)
-    {
-        points.push_back(Point(verts[i*2 + 0], verts[i*2 + 1]));
+// Fit of the stroke so far, updated on every written vertex.
+IncrementalCubicFit liveFit;
+
+// Reused by every stroke, only grow.
+PointBuffer strokePoints;
+std::vector<double> strokeTimes;
+
+// Between capture and fit, in world units: 1 pixel radial, half a pixel RDP, kept points at most 10 pixels apart.
+DecimateOptions decimation = {0.01f, 0.005f, 0.1f};
+
+// Staging for UploadBeziers, reused by every stroke, only grows.
+std::vector<float> bezierData;
+
+// Start - Control1 - End - Control2 >> P0, P1, P3, P2
+void WritePatch(const Bezier& b, float* patch){
+    const float data[2 * 4] = {b.P0.x, b.P0.y, b.P1.x, b.P1.y, b.P3.x, b.P3.y, b.P2.x, b.P2.y};
+    std::copy(data, data + 2 * 4, patch);
+}
+
+// One patch of 2 vertices per Bezier, all drawn by a single call. bVBO only grows.
+void UploadBeziers(const Bezier* beziers, int count){
+    bezierData.resize(count * 2 * 4);
+    for (int i = 0; i < count; i++) WritePatch(beziers[i], bezierData.data() + i * 2 * 4);
+
+    glBindBuffer(GL_ARRAY_BUFFER, bVBO);
+    if (count > bezierCapacity) {
+        bezierCapacity = count;
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * bezierData.size(), bezierData.data(), GL_DYNAMIC_DRAW);
     }
-    
-    const Bezier b = FitCubicBezier(points);
-    double error = EvaluateBezier(b, points);
-    std::cout << "Displaying bezier with error: " << error << std::endl;
+    else glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * bezierData.size(), bezierData.data());
 
-    // Start - Control1 - End - Control2 >> P0, P1, P3, P2
-    float data[2 * 4] = {b.P0.x, b.P0.y, b.P1.x, b.P1.y, b.P3.x, b.P3.y, b.P2.x, b.P2.y};
+    bezierCount = count;
+    isValid = true;
+}
+
+// Live fit, once per vertex. bVBO always has room for one patch, so no allocation here.
+void UploadBezier(const Bezier& b){
+    float data[2 * 4];
+    WritePatch(b, data);
 
     glBindBuffer(GL_ARRAY_BUFFER, bVBO);
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 2 * 4, data);
 
+    bezierCount = 1;
     isValid = true;
 }
 
-void WriteVertex(float x, float y){
+void RenderBezier(){
+    if (vertexCount < 4) return;
+
+    strokePoints.AssignInterleaved(verts, vertexCount);
+    strokeTimes.assign(vertexTimes, vertexTimes + vertexCount);
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t removed = Decimate(strokePoints, decimation, strokeTimes.data());
+
+    // Cut at the corners first, so they stay sharp and every stretch is fitted on its own.
+    const std::vector<std::size_t> corners = FindCorners(strokePoints, strokeTimes.data());
+    // Pieces meet with a continuous tangent everywhere but at corners, so the tessellated curve shows no kinks.
+    FitOptions options;
+    options.tangent_continuous = true;
+    const std::vector<Bezier> pieces = FitSegmentedBezier(strokePoints, corners, fitTolerance, options);
+    const double fitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Decimated " << removed << " of " << vertexCount << " points, fitted in " << fitMs << " ms" << std::endl;
+    std::cout << "Displaying " << pieces.size() << " beziers over " << corners.size() - 2 << " corners, every point kept by decimation within " << fitTolerance << " of its piece" << std::endl;
+    std::cout << "Live fit rebased " << liveFit.RebaseCount() << " times" << std::endl;
+
+    UploadBeziers(pieces.data(), (int)pieces.size());
+}
+
+void WriteVertex(float x, float y, double time){
     if (vertexCount >= maxVertices) return;
     glBindBuffer(GL_ARRAY_BUFFER, pVBO);
     float _vert[2] = {x,y};
     verts[vertexCount*2 + 0] = x;
     verts[vertexCount*2 + 1] = y;
+    vertexTimes[vertexCount] = time;
     glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 2 * vertexCount, sizeof(float) * 2, _vert); 
     std::cout << "Written vertex " << vertexCount << ": {" << x << "," << y << "}" << std::endl;
     vertexCount++;
+
+    liveFit.AddPoint(Point(x, y));
+    if (vertexCount >= 4) UploadBezier(liveFit.Current());
 }
 
 bool BtnHeld = false;
 double prevT = -1;
 double delay = 0.05;
+
+// Smooths every raw cursor event in window pixels, the time gate then picks from the smoothed stream.
+// Tuned at runtime: [ ] halve/double min_cutoff, - = halve/double beta, F turns it off and on.
+OneEuroFilter cursorFilter(OneEuroParams{1.0f, 0.005f, 1.0f});
+bool filterCursor = true;
+double filterMaxSeconds = 0; // Slowest Filter call of the stroke
+int filterSamples = 0;
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
     if (button != GLFW_MOUSE_BUTTON_LEFT) return;
     if (action == GLFW_REPEAT) return;
     BtnHeld = (action == GLFW_PRESS);
-    if (BtnHeld) { vertexCount = 0; isValid = false; }
-    if (!BtnHeld) RenderBezier();
+    if (BtnHeld) { vertexCount = 0; isValid = false; liveFit.Reset(); cursorFilter.Reset(); filterMaxSeconds = 0; filterSamples = 0; }
+    if (!BtnHeld) {
+        RenderBezier();
+        std::cout << "Cursor filter: " << filterSamples << " samples, slowest " << filterMaxSeconds * 1e6 << " us" << std::endl;
+    }
     std::cout << "\n" <<std::endl; 
 }
 
@@ -152,13 +223,40 @@ void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos){
 
     double t = glfwGetTime();
 
+    Point cursor((float)xpos, (float)ypos);
+    if (filterCursor) {
+        const auto start = std::chrono::steady_clock::now();
+        cursor = cursorFilter.Filter(cursor, t);
+        filterMaxSeconds = std::max(filterMaxSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        filterSamples++;
+    }
+
     if (t - prevT > delay || prevT < -1){
         prevT = t;
         //std::cout << "x"<<xpos<<"y"<<ypos<<" At: " << t << std::endl;
         float x,y;
-        CursorWorldPosition(xpos, ypos, &x, &y);
-        WriteVertex(x,y);
+        CursorWorldPosition(cursor.x, cursor.y, &x, &y);
+        WriteVertex(x,y,t);
+    }
+}
+
+void key_callback(GLFWwindow*, int key, int, int action, int){
+    if (action == GLFW_RELEASE) return;
+    OneEuroParams& params = cursorFilter.params;
+    switch (key)
+    {
+    case GLFW_KEY_LEFT_BRACKET:  params.min_cutoff *= 0.5f; break;
+    case GLFW_KEY_RIGHT_BRACKET: params.min_cutoff *= 2.0f; break;
+    case GLFW_KEY_MINUS:         params.beta *= 0.5f; break;
+    case GLFW_KEY_EQUAL:         params.beta *= 2.0f; break;
+    case GLFW_KEY_F:
+        // Turned back on mid-stroke, the filter must not resume from where it was turned off.
+        filterCursor = !filterCursor;
+        if (filterCursor) cursorFilter.Reset();
+        break;
+    default: return;
     }
+    std::cout << "Cursor filter " << (filterCursor ? "on" : "off") << ", min_cutoff " << params.min_cutoff << " Hz, beta " << params.beta << std::endl;
 }
 
 void PrepRender(){
@@ -199,10 +297,14 @@ int main(int argc, char const *argv[])
     bezierShader = CompileShaderProgram(LOAD_SHADER_BezierShader);
 
     PrepRender();
+    const auto tuningStart = std::chrono::steady_clock::now();
+    TuneFitSolvers();
+    std::cout << "Fit solvers tuned in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tuningStart).count() << " ms" << std::endl;
 
     glfwSetCursorPosCallback(window, cursor_pos_callback);
     glfwSetWindowSizeCallback(window, WindowSizeChangedCallback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
     
     UpdateProjection();
     while (!glfwWindowShouldClose(window))
@@ -271,7 +373,7 @@ int main(int argc, char const *argv[])
         
         glBindVertexArray(bVAO);
         glPatchParameteri(GL_PATCH_VERTICES, 2);
-        glDrawArrays(GL_PATCHES, 0, 2);
+        glDrawArrays(GL_PATCHES, 0, 2 * bezierCount);
     
         // swap buffers and poll IO events
         glfwSwapBuffers(window);